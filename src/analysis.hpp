@@ -0,0 +1,312 @@
+// Streaming link analysis: TX->RX alignment, hard-decision BER/SER, SNR/EVM
+// and ADC clip counting. TX and RX are fed block by block with bounded
+// memory, so it can run inside the streaming loop for arbitrarily long runs.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// AD9361 samples are 12-bit, sign-extended into int16.
+constexpr int16_t ADC_MAX = 2047;
+constexpr int16_t ADC_MIN = -2048;
+
+// Wilson score interval for a binomial proportion k/n at normal quantile z
+// (1.96 = 95%). Stays meaningful at k = 0, where the upper bound is ~z^2/n.
+inline void wilson_interval(uint64_t k, uint64_t n, double z, double& lo, double& hi) {
+    if (n == 0) { lo = hi = NAN; return; }
+    const double p = double(k) / double(n), z2 = z * z, nn = double(n);
+    const double centre = (p + z2 / (2 * nn)) / (1 + z2 / nn);
+    const double half = z * std::sqrt(p * (1 - p) / nn + z2 / (4 * nn * nn)) / (1 + z2 / nn);
+    lo = std::max(0.0, centre - half);
+    hi = std::min(1.0, centre + half);
+}
+
+// Fixed-capacity I/Q history addressed by absolute sample index. Pushing
+// past capacity drops the oldest samples; never allocates after construction.
+class SampleRing {
+public:
+    explicit SampleRing(size_t min_capacity) {
+        size_t cap = 1;
+        while (cap < min_capacity) cap <<= 1;
+        i_.resize(cap);
+        q_.resize(cap);
+        mask_ = cap - 1;
+    }
+
+    // i/q are read every `stride` elements (2 for interleaved I/Q).
+    void push(const int16_t* i, const int16_t* q, size_t n, size_t stride = 1) {
+        for (size_t k = 0; k < n; ++k) {
+            i_[(end_ + k) & mask_] = i[k * stride];
+            q_[(end_ + k) & mask_] = q[k * stride];
+        }
+        end_ += n;
+    }
+
+    size_t  begin()          const { return end_ > capacity() ? end_ - capacity() : 0; }
+    size_t  end()            const { return end_; }
+    size_t  capacity()       const { return mask_ + 1; }
+    int16_t i(size_t abs)    const { return i_[abs & mask_]; }
+    int16_t q(size_t abs)    const { return q_[abs & mask_]; }
+
+private:
+    std::vector<int16_t> i_, q_;
+    size_t mask_ = 0, end_ = 0;
+};
+
+class LinkAnalyzer {
+public:
+    // window:     TX symbols correlated against RX to find the loop lag
+    // max_lag:    largest RX offset searched before giving up
+    // threshold:  normalised correlation peak required to declare lock
+    // tx_history: TX symbols kept for comparison; must cover lag + TX lead
+    explicit LinkAnalyzer(size_t window = 256, size_t max_lag = 65536, double threshold = 0.5,
+                          size_t tx_history = 1u << 20)
+        : window_(window), max_lag_(max_lag), threshold_(threshold),
+          tx_(tx_history), rx_(2 * window + CHUNK),
+          tmpl_i_(window), tmpl_q_(window) {}
+
+    // Search lag ± tolerance first, e.g. around a previous marker-based
+    // latency measurement or a cached lag. If the peak is not there, the
+    // rest of [0, max_lag] is searched as without a hint, so a wrong hint
+    // costs time but not the lock. The RX history then covers the window
+    // from offset 0. Call before the first push_rx().
+    void set_lag_hint(size_t lag, size_t tolerance) {
+        const size_t lo = lag > tolerance ? lag - tolerance : 0;
+        if (lo > max_lag_) return;
+        hint_lo_ = lo;
+        hint_end_ = std::min(lag + tolerance, max_lag_) + window_ + 1;
+        search_next_ = hint_lo_;
+        in_window_ = true;
+        if (hint_end_ + window_ + CHUNK > rx_.capacity()) rx_ = SampleRing(hint_end_ + window_ + CHUNK);
+    }
+
+    // Reference symbols in transmit order.
+    void push_tx(const int16_t* i, const int16_t* q, size_t n) {
+        for (size_t k = 0; k < n && tx_.end() + k < window_; ++k) {
+            tmpl_i_[tx_.end() + k] = i[k];
+            tmpl_q_[tx_.end() + k] = q[k];
+        }
+        tx_.push(i, q, n);
+    }
+
+    // Received samples in arrival order.
+    void push_rx(const int16_t* i, const int16_t* q, size_t n) { push_rx_strided(i, q, n, 1); }
+
+    // Same, from interleaved I/Q (e.g. a memory-mapped ci16 capture).
+    void push_rx_interleaved(const int16_t* iq, size_t n) { push_rx_strided(iq, iq + 1, n, 2); }
+
+    // End of stream: accept the best offset seen so far if it clears the
+    // threshold even though it could not be confirmed, then drain.
+    void finish() {
+        if (!locked_ && !failed_ && best_norm_ >= threshold_ * threshold_) lock();
+        if (locked_) compare();
+    }
+
+    bool     locked()        const { return locked_; }
+    bool     failed()        const { return failed_; }
+    size_t   lag()           const { return lag_; }
+    double   phase()         const { return phase_; }
+    double   dc_i()          const { return dc_i_; }
+    double   dc_q()          const { return dc_q_; }
+    uint64_t clipped()       const { return clipped_; }
+    uint64_t skipped()       const { return skipped_; }
+    uint64_t symbols()       const { return symbols_; }
+    uint64_t bits()          const { return 2 * symbols_; }
+    uint64_t bit_errors()    const { return bit_errors_; }
+    uint64_t symbol_errors() const { return symbol_errors_; }
+
+    double ber() const { return symbols_ ? double(bit_errors_) / double(bits()) : NAN; }
+    double ser() const { return symbols_ ? double(symbol_errors_) / double(symbols_) : NAN; }
+
+    // Signal and noise power of the least-squares fit, in ADC units^2.
+    double signal_power() const {
+        return s_tt_ > 0 ? (s_zt_re_ * s_zt_re_ + s_zt_im_ * s_zt_im_) / s_tt_ : 0.0;
+    }
+    double noise_power() const {
+        const double n = s_zz_ - signal_power();
+        return n > 0 ? n : 0.0;
+    }
+    double snr_db() const {
+        const double n = noise_power();
+        if (!symbols_) return NAN;
+        return n > 0 ? 10.0 * std::log10(signal_power() / n) : INFINITY;
+    }
+    // RMS error vector magnitude relative to the fitted constellation.
+    double evm_rms() const {
+        const double p = signal_power();
+        return (symbols_ && p > 0) ? std::sqrt(noise_power() / p) : NAN;
+    }
+    // Image rejection of the RX path in dB from the widely linear fit
+    // z = g * t + h * conj(t): |g|^2 / |h|^2. IQ gain and phase imbalance
+    // put energy into h; QPSK makes t and conj(t) uncorrelated, so both
+    // come out of plain correlations.
+    double image_rejection_db() const {
+        const double g = s_zt_re_ * s_zt_re_ + s_zt_im_ * s_zt_im_;
+        const double h = s_zt2_re_ * s_zt2_re_ + s_zt2_im_ * s_zt2_im_;
+        if (!symbols_) return NAN;
+        return h > 0 ? 10.0 * std::log10(g / h) : INFINITY;
+    }
+    // Residual carrier frequency offset in cycles per sample (times the
+    // sample rate for Hz): mean phase step between consecutive symbols once
+    // the modulation is removed.
+    double cfo_cycles() const {
+        if (s_dphi_re_ == 0 && s_dphi_im_ == 0) return NAN;
+        return std::atan2(s_dphi_im_, s_dphi_re_) / (2 * M_PI);
+    }
+
+private:
+    static constexpr size_t CHUNK = 4096;   // RX samples handled per step
+
+    void push_rx_strided(const int16_t* i, const int16_t* q, size_t n, size_t stride) {
+        for (size_t k = 0; k < n * stride; k += stride) {
+            if (i[k] >= ADC_MAX || i[k] <= ADC_MIN || q[k] >= ADC_MAX || q[k] <= ADC_MIN)
+                clipped_++;
+        }
+        while (n > 0) {
+            const size_t c = std::min(n, CHUNK);
+            rx_.push(i, q, c, stride);
+            if (!locked_ && !failed_) search();
+            if (locked_) compare();
+            i += c * stride; q += c * stride; n -= c;
+        }
+    }
+
+    void lock() {
+        locked_ = true;
+        next_ = lag_;
+    }
+
+    // Slide the first `window_` TX symbols over the RX stream one offset at
+    // a time as RX arrives. The peak is accepted once it clears the
+    // threshold and no better offset showed up for another window's worth.
+    void search() {
+        const size_t W = window_;
+        if (tx_.end() < W) return;
+        if (tx_energy_ == 0) {
+            double e = 0, si = 0, sq = 0;
+            for (size_t k = 0; k < W; ++k) {
+                e  += double(tmpl_i_[k]) * tmpl_i_[k] + double(tmpl_q_[k]) * tmpl_q_[k];
+                si += tmpl_i_[k];
+                sq += tmpl_q_[k];
+            }
+            tx_mean_i_ = si / W;
+            tx_mean_q_ = sq / W;
+            tx_energy_ = e - W * (tx_mean_i_ * tx_mean_i_ + tx_mean_q_ * tx_mean_q_);
+        }
+        // Offsets whose samples have left the RX history can't be searched
+        if (search_next_ < rx_.begin()) search_next_ = rx_.begin();
+        for (; search_next_ + W <= rx_.end(); ++search_next_) {
+            if (in_window_ && search_next_ >= hint_end_) {
+                // Not near the hint: search the whole range, minus the window
+                in_window_ = false;
+                search_next_ = rx_.begin();
+            }
+            if (!in_window_ && search_next_ >= hint_lo_ && search_next_ < hint_end_) {
+                search_next_ = hint_end_;
+                if (search_next_ + W > rx_.end()) return;
+            }
+            const size_t o = search_next_;
+            if (o > max_lag_ + W) { failed_ = true; return; }
+            int64_t ci = 0, cq = 0, si = 0, sq = 0, ee = 0;
+            for (size_t k = 0; k < W; ++k) {
+                const int32_t ri = rx_.i(o + k), rq = rx_.q(o + k);
+                const int32_t ti = tmpl_i_[k],   tq = tmpl_q_[k];
+                ci += ri * ti + rq * tq;          // rx * conj(tx)
+                cq += rq * ti - ri * tq;
+                si += ri; sq += rq;
+                ee += ri * ri + rq * rq;
+            }
+            // Least-squares fit rx = g * tx + dc over the window: correlate
+            // mean-removed sequences, then dc = mean(rx) - g * mean(tx).
+            const double mi = double(si) / W, mq = double(sq) / W;
+            const double cre = ci - W * (mi * tx_mean_i_ + mq * tx_mean_q_);
+            const double cim = cq - W * (mq * tx_mean_i_ - mi * tx_mean_q_);
+            const double erx = double(ee) - W * (mi * mi + mq * mq);
+            const double mag2 = cre * cre + cim * cim;
+            const double norm = (erx > 0) ? mag2 / (tx_energy_ * erx) : 0.0;
+            if (norm > best_norm_) {
+                best_norm_ = norm;
+                lag_ = o;
+                phase_ = std::atan2(cim, cre);
+                dc_i_ = mi - (cre * tx_mean_i_ - cim * tx_mean_q_) / tx_energy_;
+                dc_q_ = mq - (cre * tx_mean_q_ + cim * tx_mean_i_) / tx_energy_;
+            }
+            if (best_norm_ >= threshold_ * threshold_ && o >= lag_ + W) {
+                lock();
+                return;
+            }
+        }
+    }
+
+    // Hard decisions and error statistics on every RX sample whose TX
+    // reference is available. Samples that fell out of either history are
+    // counted as skipped rather than compared.
+    void compare() {
+        if (next_ < rx_.begin()) {
+            skipped_ += rx_.begin() - next_;
+            next_ = rx_.begin();
+            have_prev_ = false;
+        }
+        if (next_ - lag_ < tx_.begin()) {
+            const size_t to = std::min(rx_.end(), tx_.begin() + lag_);
+            skipped_ += to - next_;
+            next_ = to;
+            have_prev_ = false;
+        }
+        const size_t end = std::min(rx_.end(), tx_.end() + lag_);
+        const double c = std::cos(phase_), s = std::sin(phase_);
+        for (; next_ < end; ++next_) {
+            const size_t k = next_ - lag_;
+            const double xi = rx_.i(next_) - dc_i_, xq = rx_.q(next_) - dc_q_;
+            const double zi =  xi * c + xq * s;           // (x) * e^{-j phase}
+            const double zq = -xi * s + xq * c;
+            const double ti = tx_.i(k) >= 0 ? 1.0 : -1.0;
+            const double tq = tx_.q(k) >= 0 ? 1.0 : -1.0;
+            const bool ei = (zi >= 0) != (ti > 0);
+            const bool eq = (zq >= 0) != (tq > 0);
+            bit_errors_ += ei + eq;
+            symbol_errors_ += (ei || eq);
+            symbols_++;
+            // Least-squares fit z = g * t + noise
+            s_zt_re_ += zi * ti + zq * tq;
+            s_zt_im_ += zq * ti - zi * tq;
+            s_zz_ += zi * zi + zq * zq;
+            s_tt_ += 2.0;
+            // Image term z * t, and the phase step of u = z * conj(t)
+            s_zt2_re_ += zi * ti - zq * tq;
+            s_zt2_im_ += zi * tq + zq * ti;
+            const double ui = zi * ti + zq * tq, uq = zq * ti - zi * tq;
+            if (have_prev_) {
+                s_dphi_re_ += ui * prev_ui_ + uq * prev_uq_;
+                s_dphi_im_ += uq * prev_ui_ - ui * prev_uq_;
+            }
+            prev_ui_ = ui;
+            prev_uq_ = uq;
+            have_prev_ = true;
+        }
+    }
+
+    size_t window_, max_lag_;
+    double threshold_;
+    SampleRing tx_, rx_;
+    std::vector<int16_t> tmpl_i_, tmpl_q_;   // first `window_` TX symbols
+
+    bool   locked_ = false, failed_ = false;
+    size_t search_next_ = 0;
+    size_t hint_lo_ = 0, hint_end_ = 0;      // offsets searched first, [lo, end)
+    bool   in_window_ = false;               // still searching them
+    double tx_energy_ = 0, tx_mean_i_ = 0, tx_mean_q_ = 0;   // energy is mean-removed
+    double best_norm_ = 0;
+    size_t lag_ = 0;
+    double phase_ = 0, dc_i_ = 0, dc_q_ = 0;
+
+    size_t   next_ = 0;
+    uint64_t clipped_ = 0, skipped_ = 0, symbols_ = 0, bit_errors_ = 0, symbol_errors_ = 0;
+    double   s_zt_re_ = 0, s_zt_im_ = 0, s_zz_ = 0, s_tt_ = 0;
+    double   s_zt2_re_ = 0, s_zt2_im_ = 0, s_dphi_re_ = 0, s_dphi_im_ = 0;
+    double   prev_ui_ = 0, prev_uq_ = 0;
+    bool     have_prev_ = false;
+};
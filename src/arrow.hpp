@@ -0,0 +1,281 @@
+// Arrow IPC file (Feather v2) output: one record batch of non-nullable
+// int16 columns, with run metadata as key/value pairs in the schema.
+// pandas.read_feather / pyarrow.feather load it without parsing, and the
+// column buffers map straight to numpy arrays.
+//
+// The IPC messages are FlatBuffers; the few tables needed are encoded by
+// the small builder below rather than pulling in the Arrow or FlatBuffers
+// libraries. Layout per the Arrow columnar format, metadata version V5:
+//   "ARROW1\0\0" | Schema message | RecordBatch message + body | EOS
+//   | Footer (FlatBuffer) | int32 footer size | "ARROW1"
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "seqfile.hpp"
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Arrow output assumes a little-endian host");
+
+struct ArrowColumn {
+    std::string    name;
+    const int16_t* data;    // `n` values; rows past n are written as 0
+    size_t         n;
+};
+
+using ArrowMetadata = std::vector<std::pair<std::string, std::string>>;
+
+namespace arrow_detail {
+
+// Builds a FlatBuffer back to front, like flatbuffers::FlatBufferBuilder.
+// A Ref is an object's distance from the end of the buffer.
+class FbBuilder {
+public:
+    using Ref = uint32_t;
+
+    Ref string(const std::string& s) {
+        align(4, s.size() + 1);
+        push<uint8_t>(0);
+        bytes(s.data(), s.size());
+        push<uint32_t>(static_cast<uint32_t>(s.size()));
+        return size();
+    }
+
+    Ref vector(const std::vector<Ref>& items) {
+        align(4, 4 * items.size());
+        for (size_t k = items.size(); k-- > 0;) offset(items[k]);
+        push<uint32_t>(static_cast<uint32_t>(items.size()));
+        return size();
+    }
+
+    // Vector of `count` structs of `elem` bytes, 8-byte aligned.
+    Ref struct_vector(const void* data, size_t count, size_t elem) {
+        align(4, count * elem);
+        align(8, count * elem);
+        bytes(data, count * elem);
+        push<uint32_t>(static_cast<uint32_t>(count));
+        return size();
+    }
+
+    void start_table() {
+        fields_.clear();
+        table_start_ = size();
+    }
+    template <class T> void add(unsigned id, T v) {
+        align(sizeof(T));
+        push<T>(v);
+        fields_.push_back({id, size()});
+    }
+    void add_offset(unsigned id, Ref r) {
+        align(4);
+        offset(r);
+        fields_.push_back({id, size()});
+    }
+    Ref end_table() {
+        align(4);
+        push<int32_t>(0);   // soffset to the vtable, patched below
+        const Ref table = size();
+        unsigned nslots = 0;
+        for (const auto& f : fields_) nslots = std::max(nslots, f.first + 1);
+        std::vector<uint16_t> slots(nslots, 0);
+        for (const auto& f : fields_) slots[f.first] = static_cast<uint16_t>(table - f.second);
+        for (size_t k = nslots; k-- > 0;) push<uint16_t>(slots[k]);
+        push<uint16_t>(static_cast<uint16_t>(table - table_start_));
+        push<uint16_t>(static_cast<uint16_t>(4 + 2 * nslots));
+        const int32_t soff = static_cast<int32_t>(size() - table);
+        std::memcpy(&buf_[buf_.size() - table], &soff, sizeof(soff));
+        return table;
+    }
+
+    // Writes the root offset; the result is padded to a multiple of 8.
+    std::vector<uint8_t> finish(Ref root) {
+        align(8, 4);
+        offset(root);
+        buf_.erase(buf_.begin(), buf_.begin() + static_cast<ptrdiff_t>(head_));
+        head_ = 0;
+        return std::move(buf_);
+    }
+
+private:
+    Ref size() const { return static_cast<Ref>(buf_.size() - head_); }
+
+    void reserve(size_t n) {
+        if (head_ >= n) return;
+        const size_t used = size();
+        const size_t cap = std::max<size_t>(2 * buf_.size(), used + n + 64);
+        std::vector<uint8_t> b(cap, 0);
+        std::memcpy(b.data() + cap - used, buf_.data() + head_, used);
+        buf_.swap(b);
+        head_ = cap - used;
+    }
+    void bytes(const void* p, size_t n) {
+        if (n == 0) return;
+        reserve(n);
+        head_ -= n;
+        std::memcpy(&buf_[head_], p, n);
+    }
+    template <class T> void push(T v) { bytes(&v, sizeof(v)); }
+    // Pads so that after `extra` more bytes the size is a multiple of `a`.
+    void align(size_t a, size_t extra = 0) {
+        while ((size() + extra) % a) push<uint8_t>(0);
+    }
+    void offset(Ref r) { push<uint32_t>(size() + 4 - r); }
+
+    std::vector<uint8_t> buf_;
+    size_t head_ = 0;
+    std::vector<std::pair<unsigned, Ref>> fields_;
+    Ref table_start_ = 0;
+};
+
+constexpr int16_t  METADATA_V5       = 4;
+constexpr uint8_t  HEADER_SCHEMA     = 1;
+constexpr uint8_t  HEADER_RECORD     = 3;
+constexpr uint8_t  TYPE_INT          = 2;
+constexpr uint32_t CONTINUATION      = 0xffffffffu;
+constexpr size_t   BODY_ALIGN        = 64;
+
+struct FieldNode { int64_t length, null_count; };
+struct BufferRef { int64_t offset, length; };
+struct FileBlock { int64_t offset; int32_t metadata_length; int32_t pad; int64_t body_length; };
+
+inline FbBuilder::Ref schema(FbBuilder& b, const std::vector<ArrowColumn>& cols, const ArrowMetadata& meta) {
+    std::vector<FbBuilder::Ref> fields;
+    for (const ArrowColumn& c : cols) {
+        const FbBuilder::Ref name = b.string(c.name);
+        const FbBuilder::Ref children = b.vector({});
+        b.start_table();                      // Int
+        b.add<int32_t>(0, 16);                // bitWidth
+        b.add<uint8_t>(1, 1);                 // is_signed
+        const FbBuilder::Ref type = b.end_table();
+        b.start_table();                      // Field
+        b.add_offset(0, name);
+        b.add<uint8_t>(1, 0);                 // nullable
+        b.add<uint8_t>(2, TYPE_INT);          // type_type
+        b.add_offset(3, type);
+        b.add_offset(5, children);
+        fields.push_back(b.end_table());
+    }
+    std::vector<FbBuilder::Ref> kvs;
+    for (const auto& kv : meta) {
+        const FbBuilder::Ref k = b.string(kv.first);
+        const FbBuilder::Ref v = b.string(kv.second);
+        b.start_table();                      // KeyValue
+        b.add_offset(0, k);
+        b.add_offset(1, v);
+        kvs.push_back(b.end_table());
+    }
+    const FbBuilder::Ref fvec = b.vector(fields);
+    const FbBuilder::Ref mvec = b.vector(kvs);
+    b.start_table();                          // Schema
+    b.add<int16_t>(0, 0);                     // endianness: little
+    b.add_offset(1, fvec);
+    b.add_offset(2, mvec);
+    return b.end_table();
+}
+
+inline std::vector<uint8_t> message(FbBuilder& b, uint8_t header_type, FbBuilder::Ref header,
+                                    int64_t body_length) {
+    b.start_table();                          // Message
+    b.add<int16_t>(0, METADATA_V5);
+    b.add<uint8_t>(1, header_type);
+    b.add_offset(2, header);
+    b.add<int64_t>(3, body_length);
+    return b.finish(b.end_table());
+}
+
+// Writes an encapsulated message (continuation, length, FlatBuffer,
+// padding up to a multiple of `align` in the file) and returns its size.
+inline size_t put_message(SeqFile& f, const std::vector<uint8_t>& fb, size_t align = 8) {
+    static const uint8_t ZEROS[BODY_ALIGN] = {};
+    const size_t end = f.offset() + 8 + fb.size();
+    const size_t pad = (align - end % align) % align;
+    const uint32_t len = static_cast<uint32_t>(fb.size() + pad);
+    f.append(&CONTINUATION, 4);
+    f.append(&len, 4);
+    f.append(fb.data(), fb.size());
+    f.append(ZEROS, pad);
+    return 8 + len;
+}
+
+} // namespace arrow_detail
+
+// Writes `nrows` rows of `cols` to `path`. Returns an empty string on
+// success or what failed.
+inline std::string write_arrow_ipc(const std::string& path, size_t nrows,
+                                   const std::vector<ArrowColumn>& cols, const ArrowMetadata& meta) {
+    using namespace arrow_detail;
+    SeqFile f;
+    std::string err = f.open(path);
+    if (!err.empty()) return err;
+
+    static const char MAGIC[8] = {'A', 'R', 'R', 'O', 'W', '1', 0, 0};
+    f.append(MAGIC, 8);
+    {
+        FbBuilder b;
+        const FbBuilder::Ref s = schema(b, cols, meta);
+        put_message(f, message(b, HEADER_SCHEMA, s, 0));
+    }
+
+    // Body: per column an empty validity bitmap and the values, each
+    // buffer starting on a 64-byte boundary
+    const size_t col_bytes = nrows * sizeof(int16_t);
+    const size_t col_padded = (col_bytes + BODY_ALIGN - 1) / BODY_ALIGN * BODY_ALIGN;
+    std::vector<FieldNode> nodes;
+    std::vector<BufferRef> buffers;
+    for (size_t c = 0; c < cols.size(); ++c) {
+        nodes.push_back({static_cast<int64_t>(nrows), 0});
+        buffers.push_back({static_cast<int64_t>(c * col_padded), 0});
+        buffers.push_back({static_cast<int64_t>(c * col_padded), static_cast<int64_t>(col_bytes)});
+    }
+    const int64_t body_length = static_cast<int64_t>(cols.size() * col_padded);
+
+    FileBlock block{};
+    block.offset = static_cast<int64_t>(f.offset());
+    {
+        FbBuilder b;
+        const FbBuilder::Ref bufs = b.struct_vector(buffers.data(), buffers.size(), sizeof(BufferRef));
+        const FbBuilder::Ref nds = b.struct_vector(nodes.data(), nodes.size(), sizeof(FieldNode));
+        b.start_table();                      // RecordBatch
+        b.add<int64_t>(0, static_cast<int64_t>(nrows));
+        b.add_offset(1, nds);
+        b.add_offset(2, bufs);
+        const FbBuilder::Ref rb = b.end_table();
+        // Pad the metadata so the body starts 64-byte aligned in the file
+        const std::vector<uint8_t> msg = message(b, HEADER_RECORD, rb, body_length);
+        block.metadata_length = static_cast<int32_t>(put_message(f, msg, BODY_ALIGN));
+    }
+    block.body_length = body_length;
+    static const uint8_t ZEROS[BODY_ALIGN] = {};   // column padding
+    for (const ArrowColumn& c : cols) {
+        const size_t have = std::min(c.n, nrows);
+        f.append(c.data, have * sizeof(int16_t));
+        for (size_t left = col_padded - have * sizeof(int16_t); left > 0;) {
+            const size_t k = std::min(left, sizeof(ZEROS));
+            f.append(ZEROS, k);
+            left -= k;
+        }
+    }
+    const uint32_t eos[2] = {CONTINUATION, 0};
+    f.append(eos, sizeof(eos));
+
+    FbBuilder b;
+    const FbBuilder::Ref s = schema(b, cols, meta);
+    const FbBuilder::Ref dicts = b.struct_vector(nullptr, 0, sizeof(FileBlock));
+    const FbBuilder::Ref batches = b.struct_vector(&block, 1, sizeof(FileBlock));
+    b.start_table();                          // Footer
+    b.add<int16_t>(0, METADATA_V5);
+    b.add_offset(1, s);
+    b.add_offset(2, dicts);
+    b.add_offset(3, batches);
+    const std::vector<uint8_t> footer = b.finish(b.end_table());
+    const int32_t footer_len = static_cast<int32_t>(footer.size());
+    f.append(footer.data(), footer.size());
+    f.append(&footer_len, 4);
+    f.append(MAGIC, 6);
+    return f.close();
+}
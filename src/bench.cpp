@@ -0,0 +1,297 @@
+// Microbenchmarks for the streaming hot loops (no hardware required).
+//
+//   g++ bench.cpp -O2 -std=c++17 -pthread -o bench
+//   ./bench [min_ms_per_case] [--repeat N] [--json FILE]
+//
+// Every stage runs on synthetic interleaved I/Q buffers laid out like the
+// ones libiio hands out (2 x int16 per complex sample, 4-byte step).
+// --json writes the results with host metadata for bench_compare.
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "analysis.hpp"
+#include "codec.hpp"
+#include "constellation.hpp"
+#include "markers.hpp"
+#include "psd.hpp"
+#include "shm_ring.hpp"
+#include "stream.hpp"
+
+using bench_clock = std::chrono::steady_clock;
+
+struct BenchResult {
+    std::string stage;
+    size_t      buf_samples;
+    double      samples_per_s;
+    double      ns_per_sample;
+};
+
+// Runs fn() (which processes `samples` complex samples) until it has taken
+// at least min_ms, after one untimed warm-up call. setup(), if given, runs
+// before every call outside the timed region, for stages that need fresh
+// state each time; fn() is then timed call by call.
+static BenchResult run_case(const std::string& stage, size_t samples, double min_ms,
+                            const std::function<void()>& fn, const std::function<void()>& setup) {
+    if (setup) setup();
+    fn();
+    size_t iters = 0;
+    double elapsed_ns = 0.0;
+    if (setup) {
+        do {
+            setup();
+            const auto t0 = bench_clock::now();
+            fn();
+            elapsed_ns += std::chrono::duration<double, std::nano>(bench_clock::now() - t0).count();
+            ++iters;
+        } while (elapsed_ns < min_ms * 1e6);
+    } else {
+        const auto t0 = bench_clock::now();
+        do {
+            fn();
+            ++iters;
+            elapsed_ns = std::chrono::duration<double, std::nano>(bench_clock::now() - t0).count();
+        } while (elapsed_ns < min_ms * 1e6);
+    }
+    const double total = static_cast<double>(samples) * iters;
+    return {stage, samples, total / (elapsed_ns * 1e-9), elapsed_ns / total};
+}
+
+static void print_result(const BenchResult& r) {
+    std::printf("%-10s %10zu %16.0f %12.3f\n",
+                r.stage.c_str(), r.buf_samples, r.samples_per_s, r.ns_per_sample);
+}
+
+// ---------- JSON report ----------
+static std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) out += c;
+    }
+    return out;
+}
+
+// First line of `path` that starts with `key`, with everything up to ':'
+// and surrounding blanks stripped (or the whole line if there is no key).
+static std::string read_line(const char* path, const std::string& key = "") {
+    std::ifstream ifs(path);
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (line.compare(0, key.size(), key) != 0) continue;
+        if (!key.empty()) {
+            const size_t colon = line.find(':');
+            line = (colon == std::string::npos) ? "" : line.substr(colon + 1);
+        }
+        const size_t b = line.find_first_not_of(" \t");
+        return (b == std::string::npos) ? "" : line.substr(b);
+    }
+    return "";
+}
+
+// Host, CPU and build details that decide whether two runs are comparable.
+static std::vector<std::pair<std::string, std::string>> host_metadata(double min_ms, int repeat) {
+    std::vector<std::pair<std::string, std::string>> m;
+    char host[256] = {};
+    gethostname(host, sizeof(host) - 1);
+    utsname u{};
+    uname(&u);
+    char when[32];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    m.emplace_back("timestamp", when);
+    m.emplace_back("hostname", host);
+    m.emplace_back("os", std::string(u.sysname) + " " + u.release);
+    m.emplace_back("arch", u.machine);
+    m.emplace_back("cpu_model", read_line("/proc/cpuinfo", "model name"));
+    m.emplace_back("cpu_count", std::to_string(sysconf(_SC_NPROCESSORS_ONLN)));
+    m.emplace_back("cpu_governor",
+                   read_line("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor"));
+#if defined(__clang__)
+    m.emplace_back("compiler", "clang " __clang_version__);
+#elif defined(__GNUC__)
+    m.emplace_back("compiler", "gcc " __VERSION__);
+#else
+    m.emplace_back("compiler", "unknown");
+#endif
+#ifdef __OPTIMIZE__
+    m.emplace_back("optimized", "yes");
+#else
+    m.emplace_back("optimized", "no");
+#endif
+    char ms[32];
+    std::snprintf(ms, sizeof(ms), "%g", min_ms);
+    m.emplace_back("min_ms", ms);
+    m.emplace_back("repeat", std::to_string(repeat));
+    return m;
+}
+
+static bool write_json(const std::string& path, double min_ms, int repeat,
+                       const std::vector<BenchResult>& results) {
+    std::ofstream ofs(path);
+    if (!ofs) return false;
+    ofs << "{\n  \"host\": {\n";
+    const auto meta = host_metadata(min_ms, repeat);
+    for (size_t k = 0; k < meta.size(); ++k) {
+        ofs << "    \"" << meta[k].first << "\": \"" << json_escape(meta[k].second) << "\""
+            << (k + 1 < meta.size() ? ",\n" : "\n");
+    }
+    ofs << "  },\n  \"results\": [\n";
+    char line[256];
+    for (size_t k = 0; k < results.size(); ++k) {
+        const BenchResult& r = results[k];
+        std::snprintf(line, sizeof(line),
+                      "    {\"stage\": \"%s\", \"buf_samples\": %zu, "
+                      "\"samples_per_s\": %.1f, \"ns_per_sample\": %.4f}%s\n",
+                      r.stage.c_str(), r.buf_samples, r.samples_per_s, r.ns_per_sample,
+                      k + 1 < results.size() ? "," : "");
+        ofs << line;
+    }
+    ofs << "  ]\n}\n";
+    return static_cast<bool>(ofs);
+}
+
+int main(int argc, char** argv) {
+    double min_ms = 200.0;
+    int repeat = 3;                // best of N runs per case
+    std::string json_path;
+    for (int a = 1; a < argc; ++a) {
+        const std::string arg = argv[a];
+        if (arg == "--json" && a + 1 < argc)        json_path = argv[++a];
+        else if (arg == "--repeat" && a + 1 < argc) repeat = std::max(1, std::atoi(argv[++a]));
+        else if (arg[0] != '-')                     min_ms = std::atof(arg.c_str());
+        else {
+            std::fprintf(stderr, "usage: bench [min_ms] [--repeat N] [--json FILE]\n");
+            return 1;
+        }
+    }
+    const int16_t AMP = 100;
+    const size_t SIZES[] = {1024, 4096, 16384, 65536, 262144};
+    const std::string CSV_TMP = "bench_tmp.csv";
+
+    std::vector<BenchResult> results;
+    auto measure = [&](const std::string& stage, size_t samples, const std::function<void()>& fn,
+                       const std::function<void()>& setup = {}) {
+        BenchResult best = run_case(stage, samples, min_ms, fn, setup);
+        for (int k = 1; k < repeat; ++k) {
+            const BenchResult r = run_case(stage, samples, min_ms, fn, setup);
+            if (r.samples_per_s > best.samples_per_s) best = r;
+        }
+        print_result(best);
+        results.push_back(best);
+    };
+
+    std::printf("%-10s %10s %16s %12s\n", "stage", "buf_samp", "samples/s", "ns/sample");
+
+    for (size_t n : SIZES) {
+        // Interleaved buffer: [I0 Q0 I1 Q1 ...], step = 4 bytes
+        std::vector<int16_t> buf(2 * n);
+        uint8_t* start = reinterpret_cast<uint8_t*>(buf.data());
+        const void* end = buf.data() + buf.size();
+        const ptrdiff_t inc = 2 * sizeof(int16_t);
+
+        std::vector<int16_t> vi(n), vq(n);
+
+        // ---- TX fill: RNG + interleaving + reference capture ----
+        std::mt19937 rng(42);
+        std::bernoulli_distribution bitdist(0.5);
+        measure("tx_fill", n, [&] {
+            fill_tx_block(start, end, inc, n, rng, bitdist, AMP, vi.data(), vq.data());
+        });
+
+        // ---- RX copy: de-interleave into capture arrays ----
+        std::mt19937 noise(7);
+        std::uniform_int_distribution<int> adc(-2048, 2047);
+        for (auto& s : buf) s = static_cast<int16_t>(adc(noise));
+        measure("rx_copy", n, [&] {
+            copy_rx_block(start, end, inc, n, vi.data(), vq.data());
+        });
+
+        // ---- Link analysis: lag search + BER/SNR on a delayed noisy copy ----
+        const size_t LAG = 100;
+        std::vector<int16_t> txi_ref(n), txq_ref(n), rxi_cap(n), rxq_cap(n);
+        for (size_t k = 0; k < n; ++k) {
+            txi_ref[k] = (rng() & 1) ? AMP : -AMP;
+            txq_ref[k] = (rng() & 1) ? AMP : -AMP;
+        }
+        std::normal_distribution<double> awgn(0.0, 20.0);
+        for (size_t k = 0; k < n; ++k) {
+            const bool sig = k >= LAG;
+            rxi_cap[k] = static_cast<int16_t>((sig ? 3 * txi_ref[k - LAG] : 0) + 40 + awgn(noise));
+            rxq_cap[k] = static_cast<int16_t>((sig ? 3 * txq_ref[k - LAG] : 0) - 25 + awgn(noise));
+        }
+        std::optional<LinkAnalyzer> link;
+        measure("link_ber", n, [&] {
+            link->push_tx(txi_ref.data(), txq_ref.data(), n);
+            link->push_rx(rxi_cap.data(), rxq_cap.data(), n);
+            link->finish();
+        }, [&] { link.emplace(256, 65536, 0.5, n); });   // history sized to the case
+
+        // ---- Marker detector: running autocorrelation over the RX stream ----
+        std::optional<LoopLatencyMeter> loop;
+        measure("marker_det", n, [&] {
+            loop->push_rx(rxi_cap.data(), rxq_cap.data(), n, 0);
+        }, [&] { loop.emplace(AMP, 3.84e6); });
+
+        // ---- Constellation density: 2D I/Q histogram of the RX copy ----
+        IqHistogram hist;
+        measure("iq_hist", n, [&] {
+            hist.add(rxi_cap.data(), rxq_cap.data(), n);
+        });
+
+        // ---- Welch PSD: 1024-point Hann segments, 50% overlap ----
+        WelchPsd psd(1024);
+        measure("welch_psd", n, [&] {
+            psd.push(rxi_cap.data(), rxq_cap.data(), n);
+        });
+
+        // ---- Live ring: publish the RX copy into shared memory ----
+        ShmRingWriter ring;
+        if (ring.create("bench_ring_" + std::to_string(getpid()), n, 3.84e6, 2.4e9).empty())
+            measure("shm_publish", n, [&] {
+                ring.publish(rxi_cap.data(), rxq_cap.data(), n);
+            });
+
+        // ---- Capture encoding: 12-bit pack / Rice on the noisy RX copy ----
+        std::vector<uint8_t> enc(max_block_bytes(n));
+        measure("cap_encode", n, [&] {
+            encode_block(rxi_cap.data(), rxq_cap.data(), n, enc.data());
+        });
+
+        // ---- CSV writer: n,tx_i,tx_q,rx_i,rx_q ----
+        std::vector<int16_t> ti(n), tq(n), ri(n), rq(n);
+        for (size_t k = 0; k < n; ++k) {
+            ti[k] = (k & 1) ? AMP : -AMP;
+            tq[k] = (k & 2) ? AMP : -AMP;
+            ri[k] = buf[2 * k];
+            rq[k] = buf[2 * k + 1];
+        }
+        std::vector<char> csv_scratch;
+        measure("csv_write", n, [&] {
+            if (!write_csv(CSV_TMP, n, ti.data(), tq.data(), n, ri.data(), rq.data(), n, 0, &csv_scratch)) {
+                std::fprintf(stderr, "ERROR: cannot write %s\n", CSV_TMP.c_str());
+                std::exit(1);
+            }
+        });
+    }
+
+    std::remove(CSV_TMP.c_str());
+    if (!json_path.empty() && !write_json(json_path, min_ms, repeat, results)) {
+        std::fprintf(stderr, "ERROR: cannot write %s\n", json_path.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+// Compares two `bench --json` reports and flags throughput regressions.
+//
+//   g++ bench_compare.cpp -O2 -std=c++17 -o bench_compare
+//   ./bench_compare baseline.json current.json [--threshold PCT]
+//
+// A case regresses when its samples/s dropped by more than PCT percent
+// (default 5) against the baseline. Exits 1 if any case regressed, 2 on
+// unreadable input. Host fields that differ between the two runs are
+// listed first, since numbers from different machines or compilers are not
+// comparable.
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct Report {
+    std::map<std::string, std::string> host;
+    std::map<std::pair<std::string, size_t>, double> sps;   // (stage, buf) -> samples/s
+    std::vector<std::pair<std::string, size_t>> order;      // cases in file order
+};
+
+// ---------- Minimal reader for the bench report layout ----------
+// Not a general JSON parser: it knows the flat "host" object of strings
+// and the "results" array of flat objects that bench writes.
+static std::string string_after(const std::string& s, size_t& pos) {
+    const size_t b = s.find('"', pos);
+    if (b == std::string::npos) { pos = std::string::npos; return ""; }
+    std::string out;
+    size_t k = b + 1;
+    for (; k < s.size() && s[k] != '"'; ++k) {
+        if (s[k] == '\\' && k + 1 < s.size()) ++k;
+        out += s[k];
+    }
+    pos = k + 1;
+    return out;
+}
+
+static std::string value_of(const std::string& obj, const std::string& key) {
+    const size_t k = obj.find("\"" + key + "\"");
+    if (k == std::string::npos) return "";
+    size_t v = obj.find(':', k) + 1;
+    while (v < obj.size() && (obj[v] == ' ' || obj[v] == '\t')) ++v;
+    if (v < obj.size() && obj[v] == '"') return string_after(obj, v);
+    const size_t e = obj.find_first_of(",}", v);
+    return obj.substr(v, e - v);
+}
+
+static bool load(const char* path, Report& r) {
+    std::ifstream ifs(path);
+    if (!ifs) return false;
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    const std::string s = ss.str();
+
+    const size_t hb = s.find("\"host\"");
+    const size_t rb = s.find("\"results\"");
+    if (hb == std::string::npos || rb == std::string::npos) return false;
+
+    const size_t ho = s.find('{', hb), he = s.find('}', ho);
+    for (size_t pos = ho; pos < he;) {
+        const std::string key = string_after(s, pos);
+        if (pos == std::string::npos || pos > he) break;
+        pos = s.find(':', pos) + 1;
+        r.host[key] = string_after(s, pos);
+    }
+
+    for (size_t pos = s.find('[', rb); ;) {
+        const size_t ob = s.find('{', pos);
+        if (ob == std::string::npos) break;
+        const size_t oe = s.find('}', ob);
+        const std::string obj = s.substr(ob, oe - ob + 1);
+        const auto key = std::make_pair(value_of(obj, "stage"),
+                                        static_cast<size_t>(std::atoll(value_of(obj, "buf_samples").c_str())));
+        r.sps[key] = std::atof(value_of(obj, "samples_per_s").c_str());
+        r.order.push_back(key);
+        pos = oe + 1;
+    }
+    return !r.sps.empty();
+}
+
+int main(int argc, char** argv) {
+    double threshold = 5.0;
+    std::vector<const char*> files;
+    for (int a = 1; a < argc; ++a) {
+        const std::string arg = argv[a];
+        if (arg == "--threshold" && a + 1 < argc) threshold = std::atof(argv[++a]);
+        else files.push_back(argv[a]);
+    }
+    if (files.size() != 2) {
+        std::fprintf(stderr, "usage: bench_compare baseline.json current.json [--threshold PCT]\n");
+        return 2;
+    }
+    Report base, cur;
+    for (int k = 0; k < 2; ++k) {
+        if (!load(files[k], k == 0 ? base : cur)) {
+            std::fprintf(stderr, "ERROR: cannot read bench report %s\n", files[k]);
+            return 2;
+        }
+    }
+
+    // ---------- Host differences ----------
+    static const char* COMPARABLE[] = {"cpu_model", "cpu_count", "cpu_governor", "arch",
+                                       "compiler", "optimized", "min_ms", "repeat"};
+    for (const char* key : COMPARABLE) {
+        const std::string& b = base.host[key];
+        const std::string& c = cur.host[key];
+        if (b != c) std::printf("note: %s differs: \"%s\" -> \"%s\"\n", key, b.c_str(), c.c_str());
+    }
+
+    // ---------- Per-case throughput ----------
+    std::printf("%-10s %10s %16s %16s %9s\n", "stage", "buf_samp", "base samples/s",
+                "samples/s", "change");
+    int regressions = 0;
+    for (const auto& key : cur.order) {
+        const double c = cur.sps[key];
+        const auto it = base.sps.find(key);
+        if (it == base.sps.end() || it->second <= 0) {
+            std::printf("%-10s %10zu %16s %16.0f %9s\n", key.first.c_str(), key.second, "-", c, "new");
+            continue;
+        }
+        const double change = 100.0 * (c - it->second) / it->second;
+        const bool bad = change < -threshold;
+        regressions += bad;
+        std::printf("%-10s %10zu %16.0f %16.0f %+8.1f%%%s\n", key.first.c_str(), key.second,
+                    it->second, c, change, bad ? "  REGRESSION" : "");
+    }
+    for (const auto& key : base.order) {
+        if (!cur.sps.count(key))
+            std::printf("%-10s %10zu  missing from current run\n", key.first.c_str(), key.second);
+    }
+
+    std::printf("%d regression(s) beyond %.1f%%\n", regressions, threshold);
+    return regressions ? 1 : 0;
+}
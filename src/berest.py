@@ -0,0 +1,341 @@
+"""NumPy access to the C++ capture readers and link analysis (pyapi.cpp).
+
+Build the library next to this file first:
+
+    g++ pyapi.cpp -O2 -std=c++17 -shared -fPIC -o libberest.so
+
+or point BEREST_LIB at it. ci16 captures (SigMF datasets) are memory-mapped
+and Capture.iq is a view of the mapping, so opening a multi-gigabyte
+recording costs nothing until samples are touched. Analysis arguments are
+read in place when they are C-contiguous int16 arrays.
+
+    cap = berest.Capture("run.sigmf-data")
+    rx = cap.iq                      # (n, 2) int16, zero-copy
+    res = berest.analyze(cap)        # same numbers as capture_tool analyze
+    print(res["ber"], res["snr_db"])
+
+LiveRing attaches to the shared-memory ring of a running `test --shm NAME`
+(shm_ring.hpp) and needs only NumPy, as does Daemon, the client of
+`test --serve SOCKET`.
+"""
+
+import ctypes
+import json
+import mmap
+import os
+import socket
+
+import numpy as np
+
+ABI_VERSION = 1
+
+_i16p = ctypes.POINTER(ctypes.c_int16)
+
+
+class LinkStats(ctypes.Structure):
+    _fields_ = [
+        ("locked", ctypes.c_int32),
+        ("failed", ctypes.c_int32),
+        ("lag", ctypes.c_uint64),
+        ("phase", ctypes.c_double),
+        ("dc_i", ctypes.c_double),
+        ("dc_q", ctypes.c_double),
+        ("clipped", ctypes.c_uint64),
+        ("skipped", ctypes.c_uint64),
+        ("symbols", ctypes.c_uint64),
+        ("bits", ctypes.c_uint64),
+        ("bit_errors", ctypes.c_uint64),
+        ("symbol_errors", ctypes.c_uint64),
+        ("ber", ctypes.c_double),
+        ("ber_lo", ctypes.c_double),
+        ("ber_hi", ctypes.c_double),
+        ("ser", ctypes.c_double),
+        ("ser_lo", ctypes.c_double),
+        ("ser_hi", ctypes.c_double),
+        ("snr_db", ctypes.c_double),
+        ("evm_rms", ctypes.c_double),
+        ("signal_power", ctypes.c_double),
+        ("noise_power", ctypes.c_double),
+    ]
+
+    def as_dict(self):
+        d = {name: getattr(self, name) for name, _ in self._fields_}
+        d["locked"], d["failed"] = bool(self.locked), bool(self.failed)
+        return d
+
+
+def _load():
+    path = os.environ.get("BEREST_LIB") or os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "libberest.so"
+    )
+    lib = ctypes.CDLL(path)
+    sigs = {
+        "berest_abi_version": (ctypes.c_int, []),
+        "berest_last_error": (ctypes.c_char_p, []),
+        "berest_capture_open": (ctypes.c_void_p, [ctypes.c_char_p]),
+        "berest_capture_close": (None, [ctypes.c_void_p]),
+        "berest_capture_samples": (ctypes.c_uint64, [ctypes.c_void_p]),
+        "berest_capture_packed": (ctypes.c_int, [ctypes.c_void_p]),
+        "berest_capture_sample_rate": (ctypes.c_double, [ctypes.c_void_p]),
+        "berest_capture_data": (_i16p, [ctypes.c_void_p]),
+        "berest_capture_read": (
+            ctypes.c_int64,
+            [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_uint64, _i16p, _i16p],
+        ),
+        "berest_link_new": (
+            ctypes.c_void_p,
+            [ctypes.c_uint64, ctypes.c_uint64, ctypes.c_double, ctypes.c_int16],
+        ),
+        "berest_link_free": (None, [ctypes.c_void_p]),
+        "berest_link_set_lag_hint": (None, [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_uint64]),
+        "berest_link_push_tx": (None, [ctypes.c_void_p, _i16p, _i16p, ctypes.c_uint64]),
+        "berest_link_push_rx": (None, [ctypes.c_void_p, _i16p, _i16p, ctypes.c_uint64]),
+        "berest_link_push_rx_seeded": (None, [ctypes.c_void_p, _i16p, ctypes.c_uint64]),
+        "berest_link_push_capture": (ctypes.c_int, [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint64]),
+        "berest_link_finish": (None, [ctypes.c_void_p]),
+        "berest_link_stats": (None, [ctypes.c_void_p, ctypes.POINTER(LinkStats)]),
+    }
+    for name, (res, args) in sigs.items():
+        fn = getattr(lib, name)
+        fn.restype, fn.argtypes = res, args
+    if lib.berest_abi_version() != ABI_VERSION:
+        raise ImportError(f"{path} has ABI {lib.berest_abi_version()}, expected {ABI_VERSION}; rebuild it")
+    return lib
+
+
+class _Lib:
+    """Loads the library on first use, so LiveRing works without it."""
+
+    _cdll = None
+
+    def __getattr__(self, name):
+        if _Lib._cdll is None:
+            _Lib._cdll = _load()
+        return getattr(_Lib._cdll, name)
+
+
+_lib = _Lib()
+
+
+def _error():
+    return _lib.berest_last_error().decode()
+
+
+def _ptr(a):
+    return a.ctypes.data_as(_i16p)
+
+
+def _i16(a):
+    """a as a C-contiguous int16 array, copied only if it is not one already."""
+    return np.ascontiguousarray(a, dtype=np.int16)
+
+
+class Capture:
+    """A recording: ci16_le (e.g. BASE.sigmf-data) or packed (BASE.bcap)."""
+
+    def __init__(self, path):
+        self._h = _lib.berest_capture_open(os.fsencode(path))
+        if not self._h:
+            raise OSError(_error())
+        self.path = path
+        self.packed = bool(_lib.berest_capture_packed(self._h))
+        self.sample_rate = _lib.berest_capture_sample_rate(self._h) or None
+
+    def __del__(self):
+        if getattr(self, "_h", None):
+            _lib.berest_capture_close(self._h)
+            self._h = None
+
+    def __len__(self):
+        return _lib.berest_capture_samples(self._h)
+
+    @property
+    def iq(self):
+        """(n, 2) int16 view of a ci16 capture's mapping, read-only.
+
+        The view keeps the capture open. Packed captures have no raw
+        samples to map; use read() instead.
+        """
+        if self.packed:
+            raise ValueError(f"{self.path} is packed; use read()")
+        n = len(self)
+        if n == 0:
+            return np.empty((0, 2), np.int16)
+        buf = (ctypes.c_int16 * (2 * n)).from_address(
+            ctypes.addressof(_lib.berest_capture_data(self._h).contents)
+        )
+        buf._owner = self  # the mapping lives as long as any view of it
+        a = np.frombuffer(buf, dtype=np.int16).reshape(n, 2)
+        a.flags.writeable = False
+        return a
+
+    def read(self, first=0, count=None):
+        """Samples [first, first + count) as separate I and Q arrays.
+
+        Packed captures decode just the blocks involved, straight into the
+        returned arrays.
+        """
+        count = max(0, len(self) - first) if count is None else count
+        i = np.empty(count, np.int16)
+        q = np.empty(count, np.int16)
+        got = _lib.berest_capture_read(self._h, first, count, _ptr(i), _ptr(q))
+        if got < 0:
+            raise OSError(f"{self.path}: {_error()}")
+        return i[:got], q[:got]
+
+
+class LinkAnalyzer:
+    """Streaming TX->RX alignment, BER/SER, SNR and EVM (analysis.hpp).
+
+    Feed either TX and RX blocks (push_tx/push_rx), or RX alone with
+    push_rx_seeded(), which regenerates the TX symbols from the run's seed.
+    """
+
+    def __init__(self, window=256, max_lag=65536, threshold=0.5, amp=100, lag_hint=None, tolerance=64):
+        self._h = _lib.berest_link_new(window, max_lag, threshold, amp)
+        if lag_hint is not None:
+            _lib.berest_link_set_lag_hint(self._h, lag_hint, tolerance)
+
+    def __del__(self):
+        if getattr(self, "_h", None):
+            _lib.berest_link_free(self._h)
+            self._h = None
+
+    def push_tx(self, i, q):
+        i, q = _i16(i), _i16(q)
+        _lib.berest_link_push_tx(self._h, _ptr(i), _ptr(q), min(len(i), len(q)))
+
+    def push_rx(self, i, q):
+        i, q = _i16(i), _i16(q)
+        _lib.berest_link_push_rx(self._h, _ptr(i), _ptr(q), min(len(i), len(q)))
+
+    def push_rx_seeded(self, iq):
+        """RX as an (n, 2) interleaved array, e.g. a slice of Capture.iq."""
+        iq = _i16(iq)
+        _lib.berest_link_push_rx_seeded(self._h, _ptr(iq), iq.size // 2)
+
+    def push_capture(self, cap, block=1 << 16):
+        if not _lib.berest_link_push_capture(self._h, cap._h, block):
+            raise OSError(f"{cap.path}: {_error()}")
+
+    def finish(self):
+        _lib.berest_link_finish(self._h)
+
+    def stats(self):
+        s = LinkStats()
+        _lib.berest_link_stats(self._h, ctypes.byref(s))
+        return s.as_dict()
+
+
+def analyze(cap, lag=None, block=1 << 16):
+    """Link analysis of a whole capture, run entirely in C++."""
+    if not isinstance(cap, Capture):
+        cap = Capture(cap)
+    link = LinkAnalyzer(lag_hint=lag)
+    link.push_capture(cap, block)
+    link.finish()
+    return link.stats()
+
+
+class LiveRing:
+    """Reader of the live RX ring published by `test --shm NAME`.
+
+    `data` is the (capacity, 2) int16 ring itself, for callers that check
+    `claimed` afterwards as shm_ring.hpp describes. read() and latest()
+    return checked copies.
+    """
+
+    _MAGIC, _VERSION, _DATA = 0x474E5242, 1, 4096
+    _CLAIMED, _PUBLISHED, _CLOSED = 64, 128, 136  # byte offsets in the header
+
+    def __init__(self, name):
+        with open("/dev/shm/" + name.lstrip("/"), "rb") as f:
+            self._map = mmap.mmap(f.fileno(), 0, prot=mmap.PROT_READ)
+        hdr = np.frombuffer(self._map, np.uint8, self._DATA)
+        magic, version = hdr[:8].view(np.uint32)
+        if magic != self._MAGIC or version != self._VERSION:
+            raise OSError(f"{name} is not a sample ring")
+        self.capacity = int(hdr[8:16].view(np.uint64)[0])
+        self.sample_rate, self.center_hz = hdr[16:32].view(np.float64)
+        self.start_unix_ns = int(hdr[32:40].view(np.int64)[0])
+        self._claimed = hdr[self._CLAIMED : self._CLAIMED + 8].view(np.uint64)
+        self._published = hdr[self._PUBLISHED : self._PUBLISHED + 8].view(np.uint64)
+        self._closed = hdr[self._CLOSED : self._CLOSED + 4].view(np.uint32)
+        self.data = np.frombuffer(self._map, np.int16, 2 * self.capacity, self._DATA).reshape(-1, 2)
+        self.next = self.published
+        self.lost = 0
+
+    @property
+    def published(self):
+        return int(self._published[0])
+
+    @property
+    def closed(self):
+        return bool(self._closed[0])
+
+    def _copy(self, first, end):
+        idx = np.arange(first, end) % self.capacity
+        out = self.data[idx]
+        # Anything the writer claimed a full ring past `first` may be torn
+        bad = min(end, max(first, int(self._claimed[0]) - self.capacity)) - first
+        return first + bad, out[bad:], bad
+
+    def read(self, max_samples=None):
+        """(first_sample, (n, 2) int16) published since the last call."""
+        head = self.published
+        if head - self.next > self.capacity:
+            self.lost += head - self.capacity - self.next
+            self.next = head - self.capacity
+        end = head if max_samples is None else min(head, self.next + max_samples)
+        first, out, bad = self._copy(self.next, end)
+        self.lost += bad
+        self.next = end
+        return first, out
+
+    def latest(self, n):
+        """The newest n samples (fewer if they were overwritten meanwhile)."""
+        head = self.published
+        n = min(n, self.capacity, head)
+        return self._copy(head - n, head)[1]
+
+
+class Daemon:
+    """Client of the measurement daemon (`test --serve SOCKET`).
+
+    Keyword arguments are campaign keys (campaign.hpp); values may use the
+    k/M/G suffixes as strings. Replies come back as dicts; a refused command
+    raises RuntimeError.
+    """
+
+    def __init__(self, path):
+        self._sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self._sock.connect(path)
+        self._file = self._sock.makefile("rw")
+
+    def close(self):
+        self._file.close()
+        self._sock.close()
+
+    def command(self, cmd, **settings):
+        line = " ".join([cmd] + [f"{k}={v}" for k, v in settings.items()])
+        self._file.write(line + "\n")
+        self._file.flush()
+        reply = self._file.readline()
+        if not reply:
+            raise ConnectionError("daemon closed the connection")
+        d = json.loads(reply)
+        if not d["ok"]:
+            raise RuntimeError(d["error"])
+        return d
+
+    def configure(self, **settings):
+        return self.command("configure", **settings)
+
+    def run(self, **settings):
+        return self.command("run", **settings)
+
+    def status(self):
+        return self.command("status")
+
+    def shutdown(self):
+        return self.command("shutdown")
@@ -0,0 +1,174 @@
+// Per-device calibration cache (--calibration FILE): the TX->RX lag the
+// link analysis locked at for one Pluto at one operating point, so the next
+// run searches around it first. Entries are keyed by the device serial, the
+// RX LO in 10 MHz buckets, the sample rate, the RX gain (the AGC mode, or
+// the manual gain in 6 dB buckets) and the buffer size.
+//
+// One entry per line, as key=value pairs; '#' starts a comment:
+//   serial=1044730a... lo=2400000000 rate=3840000 gain=slow_attack buf=4096 lag=1000 runs=7 updated=1760000000
+// Runs that lock update their entry; the file is rewritten on a background
+// thread so saving never delays a measurement.
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct CalibrationKey {
+    std::string serial;
+    long long   lo_hz = 0;          // bucket centre
+    long long   rate = 0;
+    std::string gain;               // AGC mode, or "manual:<dB>" with the bucket's gain
+    long long   buf = 0;
+
+    bool operator==(const CalibrationKey& o) const {
+        return serial == o.serial && lo_hz == o.lo_hz && rate == o.rate && gain == o.gain && buf == o.buf;
+    }
+    std::string text() const {
+        return "serial=" + serial + " lo=" + std::to_string(lo_hz) + " rate=" + std::to_string(rate) +
+               " gain=" + gain + " buf=" + std::to_string(buf);
+    }
+};
+
+constexpr long long CAL_LO_BUCKET_HZ   = 10000000;
+constexpr double    CAL_GAIN_BUCKET_DB = 6.0;
+
+// rx_gain_db is only used in manual mode; NaN if unknown.
+inline CalibrationKey calibration_key(const std::string& serial, long long rx_lo_hz, long long rate,
+                                      const std::string& rx_gain_mode, double rx_gain_db, long long buf) {
+    CalibrationKey k;
+    k.serial = serial;
+    k.lo_hz = std::llround(static_cast<double>(rx_lo_hz) / CAL_LO_BUCKET_HZ) * CAL_LO_BUCKET_HZ;
+    k.rate = rate;
+    if (rx_gain_mode == "manual" && std::isfinite(rx_gain_db))
+        k.gain = "manual:" + std::to_string(std::lround(rx_gain_db / CAL_GAIN_BUCKET_DB) *
+                                            static_cast<long>(CAL_GAIN_BUCKET_DB));
+    else
+        k.gain = rx_gain_mode.empty() ? "default" : rx_gain_mode;
+    k.buf = buf;
+    return k;
+}
+
+struct Calibration {
+    long long lag = -1;             // TX->RX, samples
+    uint64_t  runs = 0;             // runs that locked at this point
+    int64_t   updated = 0;          // unix seconds
+};
+
+class CalibrationStore {
+public:
+    CalibrationStore() = default;
+    ~CalibrationStore() { wait(); }
+    CalibrationStore(const CalibrationStore&) = delete;
+    CalibrationStore& operator=(const CalibrationStore&) = delete;
+
+    // A missing file is an empty cache. Returns an empty string or
+    // "path:line: what is wrong"; lines before the bad one are kept.
+    std::string load(const std::string& path) {
+        path_ = path;
+        entries_.clear();
+        std::ifstream in(path);
+        if (!in) return "";
+        std::string text;
+        for (int line = 1; std::getline(in, text); ++line) {
+            const size_t hash = text.find('#');
+            if (hash != std::string::npos) text.erase(hash);
+            std::istringstream words(text);
+            std::string word;
+            CalibrationKey k;
+            Calibration c;
+            bool any = false;
+            while (words >> word) {
+                const size_t eq = word.find('=');
+                if (eq == std::string::npos) return path + ":" + std::to_string(line) + ": expected key=value";
+                if (!set(k, c, word.substr(0, eq), word.substr(eq + 1)))
+                    return path + ":" + std::to_string(line) + ": bad '" + word + "'";
+                any = true;
+            }
+            if (!any) continue;
+            if (k.serial.empty() || k.rate <= 0 || c.lag < 0)
+                return path + ":" + std::to_string(line) + ": needs serial, rate and lag";
+            entries_.emplace_back(k, c);
+        }
+        return "";
+    }
+
+    const std::string& path() const { return path_; }
+    size_t size() const { return entries_.size(); }
+
+    const Calibration* find(const CalibrationKey& k) const {
+        for (const auto& e : entries_)
+            if (e.first == k) return &e.second;
+        return nullptr;
+    }
+
+    // Records the lag a run locked at.
+    void update(const CalibrationKey& k, long long lag, int64_t now) {
+        Calibration* c = nullptr;
+        for (auto& e : entries_)
+            if (e.first == k) c = &e.second;
+        if (!c) {
+            entries_.emplace_back(k, Calibration());
+            c = &entries_.back().second;
+        }
+        c->lag = lag;
+        c->runs++;
+        c->updated = now;
+    }
+
+    // Writes a snapshot of the cache on a background thread (through a
+    // temporary file and a rename). A save still in progress finishes first.
+    void save_async() {
+        wait();
+        std::string text = "# berest calibration cache, one entry per line\n";
+        for (const auto& e : entries_) {
+            const Calibration& c = e.second;
+            text += e.first.text() + " lag=" + std::to_string(c.lag) + " runs=" + std::to_string(c.runs) +
+                    " updated=" + std::to_string(c.updated) + "\n";
+        }
+        saver_ = std::thread([this, text = std::move(text)] {
+            const std::string tmp = path_ + ".tmp";
+            std::ofstream out(tmp);
+            out << text;
+            out.close();
+            save_error_ = (out && std::rename(tmp.c_str(), path_.c_str()) == 0) ? "" : "cannot write " + path_;
+        });
+    }
+
+    // Waits for a background save; returns its error, if any.
+    std::string wait() {
+        if (saver_.joinable()) saver_.join();
+        return save_error_;
+    }
+
+private:
+    static bool set(CalibrationKey& k, Calibration& c, const std::string& key, const std::string& val) {
+        char* end = nullptr;
+        const double v = std::strtod(val.c_str(), &end);
+        const bool num = end != val.c_str() && *end == '\0';
+        if (key == "serial") { k.serial = val; return !val.empty(); }
+        if (key == "gain")   { k.gain = val; return !val.empty(); }
+        if (!num) return false;
+        if (key == "lo")          k.lo_hz = std::llround(v);
+        else if (key == "rate")   k.rate = std::llround(v);
+        else if (key == "buf")    k.buf = std::llround(v);
+        else if (key == "lag")    c.lag = std::llround(v);
+        else if (key == "runs")   c.runs = static_cast<uint64_t>(v);
+        else if (key == "updated") c.updated = static_cast<int64_t>(v);
+        else return false;
+        return true;
+    }
+
+    std::string                                          path_;
+    std::vector<std::pair<CalibrationKey, Calibration>> entries_;
+    std::thread                                          saver_;
+    std::string                                          save_error_;
+};
@@ -0,0 +1,172 @@
+// Measurement campaigns: a text file listing many measurement points that
+// one process runs back to back on the same radio.
+//
+//   # comments run to the end of the line
+//   defaults rate=3.84M bw=5M seconds=2 amp=100
+//   name=ch1 lo=2.40G
+//   name=ch2 lo=2.45G rx_gain=40 gain_mode=manual
+//   name=ch3 rx_lo=2.5G tx_lo=2.5G tx_gain=-20 samples=2000000
+//
+// Every other line is one point of whitespace-separated key=value pairs.
+// A `defaults` line changes the values that later points start from.
+// Numbers take k/M/G suffixes. Keys:
+//   name        label in the output
+//   rate, bw    sample rate and RF bandwidth, Hz
+//   lo          RX and TX LO together; rx_lo, tx_lo separately, Hz
+//   gain_mode   RX gain control: manual, slow_attack, fast_attack, hybrid
+//   rx_gain     RX gain in dB (manual mode); tx_gain TX gain in dB (<= 0)
+//   mod         modulation; only qpsk is implemented
+//   amp         TX symbol amplitude, 1..2047
+//   samples     samples per point, or seconds for a fixed duration;
+//               symbols is the same as samples (one QPSK symbol per sample)
+//   buf         samples per RX/TX buffer
+//   lag         TX->RX lag hint for the alignment search, samples
+// Gains left unset stay as the radio has them.
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "analysis.hpp"
+
+struct CampaignPoint {
+    std::string name;
+    int         line = 0;               // in the campaign file
+    long long   sample_rate = 0;
+    long long   rf_bandwidth = 0;
+    long long   rx_lo_hz = 0, tx_lo_hz = 0;
+    std::string rx_gain_mode;           // "" = leave as is
+    double      rx_gain_db = NAN;       // NaN = leave as is
+    double      tx_gain_db = NAN;
+    std::string modulation = "qpsk";
+    int         amp = 100;
+    size_t      nsamples = 0;           // 0 = run for `seconds`
+    double      seconds = 0;
+    size_t      buf_samples = 4096;
+    long long   lag_hint = -1;
+};
+
+namespace campaign_detail {
+
+// Parses "2.4G", "3.84M", "-20", ...
+inline bool parse_number(const std::string& s, double& v) {
+    char* end = nullptr;
+    v = std::strtod(s.c_str(), &end);
+    if (end == s.c_str()) return false;
+    const std::string suffix(end);
+    if (suffix == "k")      v *= 1e3;
+    else if (suffix == "M") v *= 1e6;
+    else if (suffix == "G") v *= 1e9;
+    else if (!suffix.empty()) return false;
+    return std::isfinite(v);
+}
+
+// Applies one key=value to p. Returns an empty string or what is wrong.
+inline std::string set(CampaignPoint& p, const std::string& key, const std::string& val) {
+    if (key == "name")      { p.name = val; return ""; }
+    if (key == "gain_mode") {
+        if (val != "manual" && val != "slow_attack" && val != "fast_attack" && val != "hybrid")
+            return "unknown gain_mode '" + val + "'";
+        p.rx_gain_mode = val;
+        return "";
+    }
+    if (key == "mod") {
+        if (val != "qpsk") return "modulation '" + val + "' is not supported (only qpsk)";
+        p.modulation = val;
+        return "";
+    }
+    double v;
+    if (!parse_number(val, v)) return "bad number '" + val + "' for " + key;
+    const long long ll = std::llround(v);
+    if (key == "rate")         p.sample_rate = ll;
+    else if (key == "bw")      p.rf_bandwidth = ll;
+    else if (key == "lo")      p.rx_lo_hz = p.tx_lo_hz = ll;
+    else if (key == "rx_lo")   p.rx_lo_hz = ll;
+    else if (key == "tx_lo")   p.tx_lo_hz = ll;
+    else if (key == "rx_gain") p.rx_gain_db = v;
+    else if (key == "tx_gain") p.tx_gain_db = v;
+    else if (key == "amp")     p.amp = static_cast<int>(ll);
+    else if (key == "samples" || key == "symbols") { p.nsamples = ll > 0 ? static_cast<size_t>(ll) : 0; p.seconds = 0; }
+    else if (key == "seconds") { p.seconds = v; p.nsamples = 0; }
+    else if (key == "buf")     p.buf_samples = ll > 0 ? static_cast<size_t>(ll) : 0;
+    else if (key == "lag")     p.lag_hint = ll;
+    else return "unknown key '" + key + "'";
+    return "";
+}
+
+inline std::string check(const CampaignPoint& p) {
+    if (p.sample_rate <= 0 || p.rf_bandwidth <= 0) return "rate and bw must be positive";
+    if (p.rx_lo_hz <= 0 || p.tx_lo_hz <= 0)        return "LOs must be positive";
+    if (p.amp <= 0 || p.amp > ADC_MAX)              return "amp must be in 1.." + std::to_string(ADC_MAX);
+    if (p.nsamples == 0 && !(p.seconds > 0))        return "needs samples or seconds";
+    if (p.buf_samples == 0)                         return "buf must be positive";
+    if (p.tx_gain_db > 0)                           return "tx_gain must be <= 0 dB";
+    if (!std::isnan(p.rx_gain_db) && p.rx_gain_mode != "manual") return "rx_gain needs gain_mode=manual";
+    return "";
+}
+
+} // namespace campaign_detail
+
+// Applies whitespace-separated key=value pairs (the syntax of a point line)
+// to `p`, e.g. for a point sent over the daemon's control socket. Returns an
+// empty string on success or what is wrong; `p` is unchanged on error.
+inline std::string apply_settings(CampaignPoint& p, const std::string& text) {
+    using namespace campaign_detail;
+    CampaignPoint q = p;
+    std::istringstream words(text);
+    std::string word;
+    while (words >> word) {
+        const size_t eq = word.find('=');
+        const std::string err = eq == std::string::npos ? "expected key=value, got '" + word + "'"
+                                                        : set(q, word.substr(0, eq), word.substr(eq + 1));
+        if (!err.empty()) return err;
+    }
+    const std::string err = check(q);
+    if (!err.empty()) return err;
+    p = q;
+    return "";
+}
+
+// Reads `path` into `points`, each starting from `defaults`. Returns an
+// empty string on success or "path:line: what is wrong".
+inline std::string parse_campaign(const std::string& path, CampaignPoint defaults,
+                                  std::vector<CampaignPoint>& points) {
+    using namespace campaign_detail;
+    std::ifstream in(path);
+    if (!in) return "cannot read " + path;
+    points.clear();
+    std::string text;
+    for (int line = 1; std::getline(in, text); ++line) {
+        const size_t hash = text.find('#');
+        if (hash != std::string::npos) text.erase(hash);
+        std::istringstream words(text);
+        std::string word;
+        if (!(words >> word)) continue;
+        const bool is_defaults = word == "defaults";
+        CampaignPoint p = defaults;
+        p.line = line;
+        if (is_defaults && !(words >> word)) continue;
+        do {
+            const size_t eq = word.find('=');
+            const std::string err = eq == std::string::npos
+                                        ? "expected key=value, got '" + word + "'"
+                                        : set(p, word.substr(0, eq), word.substr(eq + 1));
+            if (!err.empty()) return path + ":" + std::to_string(line) + ": " + err;
+        } while (words >> word);
+        if (is_defaults) {
+            defaults = p;
+            continue;
+        }
+        if (p.name.empty() || p.name == defaults.name) p.name = "point " + std::to_string(points.size() + 1);
+        const std::string err = check(p);
+        if (!err.empty()) return path + ":" + std::to_string(line) + ": " + err;
+        points.push_back(std::move(p));
+    }
+    if (points.empty()) return path + " lists no measurement points";
+    return "";
+}
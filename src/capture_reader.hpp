@@ -0,0 +1,266 @@
+// Memory-mapped readers for recordings. MappedCapture reads ci16_le
+// captures (SigMF datasets, capture_tool decode output): samples are
+// exposed as zero-copy spans into the mapping, and block iteration asks the
+// kernel to read ahead and to drop what was consumed, so a capture larger
+// than RAM streams through a bounded working set. PackedCapture gives
+// random access to packed captures (.bcap) through their block index.
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "codec.hpp"
+
+// Interleaved I/Q view: sample k is (iq[2k], iq[2k+1]).
+struct IqSpan {
+    const int16_t* iq = nullptr;
+    size_t         n = 0;
+
+    int16_t i(size_t k) const { return iq[2 * k]; }
+    int16_t q(size_t k) const { return iq[2 * k + 1]; }
+};
+
+class MappedCapture {
+public:
+    MappedCapture() = default;
+    ~MappedCapture() { close(); }
+    MappedCapture(const MappedCapture&) = delete;
+    MappedCapture& operator=(const MappedCapture&) = delete;
+
+    // Returns an empty string on success or what failed.
+    std::string open(const std::string& path) {
+        close();
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return path + ": " + std::strerror(errno);
+        struct stat sb{};
+        if (fstat(fd, &sb) != 0) {
+            const std::string err = path + ": " + std::strerror(errno);
+            ::close(fd);
+            return err;
+        }
+        bytes_ = static_cast<size_t>(sb.st_size);
+        if (bytes_ % (2 * sizeof(int16_t)) != 0) {
+            ::close(fd);
+            return path + ": size is not a whole number of ci16 samples";
+        }
+        if (bytes_ > 0) {
+            void* p = mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) {
+                const std::string err = path + ": mmap: " + std::strerror(errno);
+                ::close(fd);
+                return err;
+            }
+            base_ = static_cast<const int16_t*>(p);
+            madvise(const_cast<int16_t*>(base_), bytes_, MADV_SEQUENTIAL);
+        }
+        ::close(fd);   // the mapping keeps the file referenced
+        return "";
+    }
+
+    void close() {
+        if (base_) munmap(const_cast<int16_t*>(base_), bytes_);
+        base_ = nullptr;
+        bytes_ = 0;
+    }
+
+    size_t size() const { return bytes_ / (2 * sizeof(int16_t)); }
+
+    // Samples [first, first + n), clipped to the end of the capture.
+    IqSpan span(size_t first, size_t n) const {
+        if (first >= size()) return {};
+        return {base_ + 2 * first, std::min(n, size() - first)};
+    }
+
+    // Calls fn(IqSpan) on consecutive blocks of `block` samples. The next
+    // `readahead` blocks are requested ahead of use and pages behind the
+    // current block are released, keeping resident memory bounded.
+    template <class Fn> void for_each_block(size_t block, Fn fn, size_t readahead = 4) const {
+        const size_t PAGE = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t BYTES_PER_SAMPLE = 2 * sizeof(int16_t);
+        size_t released = 0;   // bytes [0, released) already given back
+        for (size_t first = 0; first < size(); first += block) {
+            // Read ahead from the page holding the next block
+            const size_t ahead = (first + block) * BYTES_PER_SAMPLE / PAGE * PAGE;
+            const size_t ahead_end = std::min(bytes_, (first + block * (1 + readahead)) * BYTES_PER_SAMPLE);
+            if (ahead < ahead_end) advise(ahead, ahead_end - ahead, MADV_WILLNEED);
+
+            fn(span(first, block));
+
+            // Drop whole pages that lie entirely before the next block
+            const size_t done = std::min(bytes_, (first + block) * BYTES_PER_SAMPLE) / PAGE * PAGE;
+            if (done > released) {
+                advise(released, done - released, MADV_DONTNEED);
+                released = done;
+            }
+        }
+    }
+
+private:
+    void advise(size_t offset, size_t len, int advice) const {
+        madvise(reinterpret_cast<char*>(const_cast<int16_t*>(base_)) + offset, len, advice);
+    }
+
+    const int16_t* base_ = nullptr;
+    size_t         bytes_ = 0;
+};
+
+// ---------- Packed captures ----------
+// Blocks are located through the index at the end of the file, or by
+// walking the block headers if there is none. decode() only reads the
+// mapping, so threads may decode different blocks concurrently.
+class PackedCapture {
+public:
+    PackedCapture() = default;
+    ~PackedCapture() { close(); }
+    PackedCapture(const PackedCapture&) = delete;
+    PackedCapture& operator=(const PackedCapture&) = delete;
+
+    // Returns an empty string on success or what failed.
+    std::string open(const std::string& path) {
+        close();
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return path + ": " + std::strerror(errno);
+        struct stat sb{};
+        if (fstat(fd, &sb) != 0 || sb.st_size < static_cast<off_t>(sizeof(CaptureFileHeader))) {
+            ::close(fd);
+            return path + " is not a packed capture";
+        }
+        bytes_ = static_cast<size_t>(sb.st_size);
+        void* p = mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return path + ": mmap: " + std::strerror(errno);
+        base_ = static_cast<const uint8_t*>(p);
+
+        CaptureFileHeader fh;
+        std::memcpy(&fh, base_, sizeof(fh));
+        if (fh.magic != CAPTURE_MAGIC) return path + " is not a packed capture";
+        if (fh.version < 1 || fh.version > CAPTURE_VERSION)
+            return path + ": unsupported capture version " + std::to_string(fh.version);
+        block_samples_ = fh.block_samples;
+        if (!read_index()) scan_blocks();
+        return "";
+    }
+
+    void close() {
+        if (base_) munmap(const_cast<uint8_t*>(base_), bytes_);
+        base_ = nullptr;
+        bytes_ = 0;
+        index_.clear();
+        samples_ = 0;
+        rate_ = 0;
+        indexed_ = false;
+        truncated_ = false;
+    }
+
+    size_t   blocks()        const { return index_.size(); }
+    uint64_t samples()       const { return samples_; }
+    size_t   block_samples() const { return block_samples_; }
+    size_t   file_bytes()    const { return bytes_; }
+    double   sample_rate()   const { return rate_; }         // 0 = not recorded
+    bool     indexed()       const { return indexed_; }      // index read from the file
+    bool     truncated()     const { return truncated_; }    // garbage after the last good block
+    const IndexEntry& entry(size_t b) const { return index_[b]; }
+    size_t   block_size(size_t b) const {
+        return static_cast<size_t>((b + 1 < index_.size() ? index_[b + 1].first_sample : samples_) -
+                                   index_[b].first_sample);
+    }
+
+    BlockHeader header(size_t b) const {
+        BlockHeader h;
+        std::memcpy(&h, base_ + index_[b].offset, sizeof(h));
+        return h;
+    }
+
+    // Block holding sample `s`, or blocks() if past the end. O(log blocks).
+    size_t block_of_sample(uint64_t s) const {
+        if (s >= samples_) return blocks();
+        auto it = std::upper_bound(index_.begin(), index_.end(), s,
+                                   [](uint64_t v, const IndexEntry& e) { return v < e.first_sample; });
+        return static_cast<size_t>(it - index_.begin()) - 1;
+    }
+
+    // Sample that arrived at wall-clock `unix_ns`, clamped to the capture.
+    // Returns false if the capture has no timestamps. O(log blocks).
+    bool sample_at_time(int64_t unix_ns, uint64_t& s) const {
+        if (index_.empty() || index_.front().unix_ns == 0 || rate_ <= 0) return false;
+        auto it = std::upper_bound(index_.begin(), index_.end(), unix_ns,
+                                   [](int64_t v, const IndexEntry& e) { return v < e.unix_ns; });
+        const size_t b = it == index_.begin() ? 0 : static_cast<size_t>(it - index_.begin()) - 1;
+        const double into = std::max(0.0, (unix_ns - index_[b].unix_ns) * 1e-9 * rate_);
+        s = std::min<uint64_t>(index_[b].first_sample + static_cast<uint64_t>(into),
+                               samples_ ? samples_ - 1 : 0);
+        return true;
+    }
+
+    // Decodes block b into i/q (room for block_samples()). Returns false if
+    // it is corrupt.
+    bool decode(size_t b, int16_t* i, int16_t* q, size_t& n) const {
+        const size_t off = static_cast<size_t>(index_[b].offset);
+        return decode_block(base_ + off, data_end_ - off, i, q, block_samples_, n) != 0 &&
+               n == block_size(b);
+    }
+
+private:
+    bool read_index() {
+        IndexFooter f;
+        if (bytes_ < sizeof(CaptureFileHeader) + sizeof(f)) return false;
+        std::memcpy(&f, base_ + bytes_ - sizeof(f), sizeof(f));
+        if (f.magic != INDEX_MAGIC || f.index_offset < sizeof(CaptureFileHeader) ||
+            f.entries > (bytes_ - sizeof(f)) / sizeof(IndexEntry) ||
+            f.index_offset + f.entries * sizeof(IndexEntry) + sizeof(f) != bytes_)
+            return false;
+        index_.resize(static_cast<size_t>(f.entries));
+        std::memcpy(index_.data(), base_ + f.index_offset, index_.size() * sizeof(IndexEntry));
+        for (size_t b = 0; b < index_.size(); ++b) {
+            const IndexEntry& e = index_[b];
+            if (e.offset + sizeof(BlockHeader) > f.index_offset ||
+                (b > 0 && (e.first_sample <= index_[b - 1].first_sample ||
+                           e.offset <= index_[b - 1].offset)) ||
+                e.first_sample >= f.samples) {
+                index_.clear();
+                return false;
+            }
+        }
+        samples_ = f.samples;
+        rate_ = f.sample_rate;
+        data_end_ = static_cast<size_t>(f.index_offset);
+        indexed_ = true;
+        return true;
+    }
+
+    void scan_blocks() {
+        size_t off = sizeof(CaptureFileHeader);
+        while (off + sizeof(BlockHeader) <= bytes_) {
+            BlockHeader h;
+            std::memcpy(&h, base_ + off, sizeof(h));
+            if (h.magic != BLOCK_MAGIC || h.nsamples == 0 || h.nsamples > block_samples_ ||
+                h.payload_bytes > bytes_ - off - sizeof(h))
+                break;
+            index_.push_back({off, samples_, 0});
+            samples_ += h.nsamples;
+            off += sizeof(h) + h.payload_bytes;
+        }
+        data_end_ = off;
+        truncated_ = off != bytes_;
+    }
+
+    const uint8_t*          base_ = nullptr;
+    size_t                  bytes_ = 0;
+    size_t                  data_end_ = 0;        // end of the block data
+    size_t                  block_samples_ = 0;
+    std::vector<IndexEntry> index_;
+    uint64_t                samples_ = 0;
+    double                  rate_ = 0;
+    bool                    indexed_ = false;
+    bool                    truncated_ = false;
+};
@@ -0,0 +1,380 @@
+// Offline tool for recordings: packed captures (.bcap, see codec.hpp) and
+// ci16_le SigMF datasets.
+//
+//   g++ capture_tool.cpp -O2 -std=c++17 -pthread -o capture_tool
+//   ./capture_tool info    IN.bcap
+//   ./capture_tool decode  IN.bcap OUT.sigmf-data [--threads N]
+//   ./capture_tool extract IN.bcap OUT.sigmf-data [--sample S | --at SECONDS]
+//                          [--count N | --seconds SECONDS] [--threads N]
+//   ./capture_tool analyze IN.sigmf-data [--lag SAMPLES] [--block N]
+//   ./capture_tool constellation IN.sigmf-data OUT.png|OUT.npy [--bits B] [--threads N]
+//   ./capture_tool live NAME [--seconds S] [--constellation OUT.png|OUT.npy]
+//
+// `decode` and `extract` write plain interleaved ci16_le, the SigMF dataset
+// format. `extract` seeks through the block index to a sample number or to
+// a time from the start of the capture and decodes only what it needs;
+// both decode ranges of blocks in parallel.
+// `analyze` memory-maps a ci16_le RX capture, regenerates the TX reference
+// from the seed and runs the lag search, BER/SER, SNR and EVM over it
+// without reading the file into memory. `constellation` bins the same kind
+// of capture into a 2^B x 2^B I/Q density histogram, one per thread over its
+// share of the file, merged at the end. `live` attaches to the shared-memory
+// ring of a running `test --shm NAME` and reports rate, level and lost
+// samples once a second, reading the samples in place.
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "analysis.hpp"
+#include "capture_reader.hpp"
+#include "codec.hpp"
+#include "constellation.hpp"
+#include "latency.hpp"
+#include "shm_ring.hpp"
+#include "stream.hpp"
+
+static void fatal(const std::string& msg) {
+    std::fprintf(stderr, "ERROR: %s\n", msg.c_str());
+    std::exit(1);
+}
+
+static void usage() {
+    std::fprintf(stderr, "usage: capture_tool info IN.bcap\n"
+                         "       capture_tool decode IN.bcap OUT.sigmf-data [--threads N]\n"
+                         "       capture_tool extract IN.bcap OUT.sigmf-data [--sample S | --at SECONDS]\n"
+                         "                            [--count N | --seconds SECONDS] [--threads N]\n"
+                         "       capture_tool analyze IN.sigmf-data [--lag SAMPLES] [--block N]\n"
+                         "       capture_tool constellation IN.sigmf-data OUT.png|OUT.npy [--bits B]\n"
+                         "                                  [--threads N]\n"
+                         "       capture_tool live NAME [--seconds S] [--constellation OUT.png|OUT.npy]\n");
+    std::exit(1);
+}
+
+// Interleaved ci16_le output written at sample offsets, so ranges of
+// blocks can be decoded into it from several threads.
+class OffsetFile {
+public:
+    ~OffsetFile() { if (fd_ >= 0) ::close(fd_); }
+
+    void open(const std::string& path, uint64_t samples) {
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) fatal(path + ": " + std::strerror(errno));
+        if (ftruncate(fd_, static_cast<off_t>(samples * 4)) != 0)
+            fatal(path + ": " + std::strerror(errno));
+    }
+
+    bool write_at(uint64_t sample, const int16_t* iq, size_t n) const {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(iq);
+        size_t left = n * 2 * sizeof(int16_t);
+        off_t  off = static_cast<off_t>(sample * 2 * sizeof(int16_t));
+        while (left > 0) {
+            const ssize_t w = pwrite(fd_, p, left, off);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            p += w; off += w;
+            left -= static_cast<size_t>(w);
+        }
+        return true;
+    }
+
+    bool close() {
+        const bool ok = ::close(fd_) == 0;
+        fd_ = -1;
+        return ok;
+    }
+
+private:
+    int fd_ = -1;
+};
+
+// Decodes samples [from, from + count) of `in` into `out`. The blocks are
+// split into one contiguous range per thread; each block decodes on its own.
+static void decode_range(const PackedCapture& in, uint64_t from, uint64_t count,
+                         const OffsetFile& out, unsigned threads) {
+    if (count == 0) return;
+    const size_t b0 = in.block_of_sample(from);
+    const size_t nb = in.block_of_sample(from + count - 1) + 1 - b0;
+    threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, nb)));
+
+    std::vector<std::string> errs(threads);
+    auto work = [&](unsigned t) {
+        std::vector<int16_t> i(in.block_samples()), q(in.block_samples()), iq(2 * in.block_samples());
+        for (size_t b = b0 + nb * t / threads; b < b0 + nb * (t + 1) / threads; ++b) {
+            size_t n = 0;
+            if (!in.decode(b, i.data(), q.data(), n)) {
+                errs[t] = "corrupt block " + std::to_string(b);
+                return;
+            }
+            const uint64_t s0 = in.entry(b).first_sample;
+            const uint64_t lo = std::max(from, s0);
+            const uint64_t hi = std::min(from + count, s0 + n);
+            for (uint64_t s = lo; s < hi; ++s) {
+                iq[2 * (s - lo)]     = i[s - s0];
+                iq[2 * (s - lo) + 1] = q[s - s0];
+            }
+            if (!out.write_at(lo - from, iq.data(), static_cast<size_t>(hi - lo))) {
+                errs[t] = std::strerror(errno);
+                return;
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(work, t);
+    work(0);
+    for (std::thread& th : pool) th.join();
+    for (const std::string& e : errs)
+        if (!e.empty()) fatal(e);
+}
+
+static std::string utc_time(int64_t unix_ns) {
+    const std::time_t secs = static_cast<std::time_t>(unix_ns / 1000000000);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", std::gmtime(&secs));
+    char frac[16];
+    std::snprintf(frac, sizeof(frac), ".%03dZ", static_cast<int>(unix_ns / 1000000 % 1000));
+    return std::string(buf) + frac;
+}
+
+static void open_packed(PackedCapture& in, const char* path) {
+    const std::string err = in.open(path);
+    if (!err.empty()) fatal(err);
+    if (in.truncated())
+        std::fprintf(stderr, "Warning: %s ends in an incomplete block; using the %zu complete ones.\n",
+                     path, in.blocks());
+}
+
+static unsigned default_threads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) usage();
+    const std::string cmd = argv[1];
+
+    if (cmd == "info" && argc == 3) {
+        PackedCapture in;
+        open_packed(in, argv[2]);
+        uint64_t blocks[2] = {0, 0};
+        for (size_t b = 0; b < in.blocks(); ++b) blocks[in.header(b).codec == CODEC_PACK12 ? 0 : 1]++;
+        std::printf("samples      %llu\n", static_cast<unsigned long long>(in.samples()));
+        std::printf("blocks       %llu 12-bit, %llu Rice\n",
+                    static_cast<unsigned long long>(blocks[0]),
+                    static_cast<unsigned long long>(blocks[1]));
+        std::printf("size         %zu bytes (%.1f%% of ci16)\n", in.file_bytes(),
+                    in.samples() ? 100.0 * in.file_bytes() / (4.0 * in.samples()) : 0.0);
+        std::printf("index        %s\n", in.indexed() ? "yes" : "no (rebuilt from block headers)");
+        if (in.sample_rate() > 0)
+            std::printf("sample rate  %.0f Hz (%.3f s)\n", in.sample_rate(),
+                        in.samples() / in.sample_rate());
+        if (in.blocks() && in.entry(0).unix_ns)
+            std::printf("time         %s .. %s\n", utc_time(in.entry(0).unix_ns).c_str(),
+                        utc_time(in.entry(in.blocks() - 1).unix_ns).c_str());
+        return 0;
+    }
+    if (cmd == "decode" || cmd == "extract") {
+        if (argc < 4) usage();
+        PackedCapture in;
+        open_packed(in, argv[2]);
+        unsigned threads = default_threads();
+        double at = -1, seconds = -1;
+        long long from = -1, count = -1;
+        for (int a = 4; a < argc; ++a) {
+            const std::string arg = argv[a];
+            if (arg == "--threads" && a + 1 < argc)  threads = static_cast<unsigned>(std::atoi(argv[++a]));
+            else if (cmd == "decode") usage();
+            else if (arg == "--sample" && a + 1 < argc)  from = std::atoll(argv[++a]);
+            else if (arg == "--at" && a + 1 < argc)      at = std::atof(argv[++a]);
+            else if (arg == "--count" && a + 1 < argc)   count = std::atoll(argv[++a]);
+            else if (arg == "--seconds" && a + 1 < argc) seconds = std::atof(argv[++a]);
+            else usage();
+        }
+        if (threads == 0 || (from >= 0 && at >= 0) || (count >= 0 && seconds >= 0)) usage();
+        if ((at >= 0 || seconds >= 0) && in.sample_rate() <= 0)
+            fatal(std::string(argv[2]) + " has no sample rate; use --sample and --count");
+
+        uint64_t first = from >= 0 ? static_cast<uint64_t>(from) : 0;
+        if (at >= 0) {
+            // Wall-clock offset from the first sample, via the block timestamps
+            // when they were recorded, else by sample count
+            if (!in.sample_at_time(in.blocks() ? in.entry(0).unix_ns + static_cast<int64_t>(at * 1e9) : 0, first))
+                first = static_cast<uint64_t>(at * in.sample_rate());
+        }
+        first = std::min<uint64_t>(first, in.samples());
+        uint64_t n = in.samples() - first;
+        if (count >= 0)   n = std::min<uint64_t>(n, static_cast<uint64_t>(count));
+        if (seconds >= 0) n = std::min<uint64_t>(n, static_cast<uint64_t>(seconds * in.sample_rate()));
+
+        OffsetFile out;
+        out.open(argv[3], n);
+        const uint64_t t0 = mono_ns();
+        decode_range(in, first, n, out, threads);
+        if (!out.close()) fatal(std::string(argv[3]) + ": " + std::strerror(errno));
+        const double secs = (mono_ns() - t0) * 1e-9;
+        std::printf("Wrote %s with %llu samples from sample %llu (%.1f MS/s, %u threads).\n",
+                    argv[3], static_cast<unsigned long long>(n),
+                    static_cast<unsigned long long>(first), secs > 0 ? n / secs * 1e-6 : 0.0, threads);
+        return 0;
+    }
+    if (cmd == "analyze") {
+        long long lag_hint = -1;
+        size_t block = 1u << 16;
+        for (int a = 3; a < argc; ++a) {
+            const std::string arg = argv[a];
+            if (arg == "--lag" && a + 1 < argc)        lag_hint = std::atoll(argv[++a]);
+            else if (arg == "--block" && a + 1 < argc) block = std::strtoull(argv[++a], nullptr, 0);
+            else usage();
+        }
+        if (block == 0) usage();
+        MappedCapture cap;
+        const std::string err = cap.open(argv[2]);
+        if (!err.empty()) fatal(err);
+
+        // Reference amplitude only scales the fit; the decisions use signs.
+        const int16_t AMP = 100;
+        const size_t LAG_TOLERANCE = 64;
+        LinkAnalyzer link;
+        if (lag_hint >= 0) link.set_lag_hint(static_cast<size_t>(lag_hint), LAG_TOLERANCE);
+        std::mt19937 rng(TX_SEED);
+        std::bernoulli_distribution bitdist(0.5);
+        std::vector<int16_t> ti(block), tq(block);
+
+        const uint64_t t0 = mono_ns();
+        cap.for_each_block(block, [&](const IqSpan& s) {
+            qpsk_reference(rng, bitdist, AMP, ti.data(), tq.data(), s.n);
+            link.push_tx(ti.data(), tq.data(), s.n);
+            link.push_rx_interleaved(s.iq, s.n);
+        });
+        link.finish();
+        const double secs = (mono_ns() - t0) * 1e-9;
+
+        std::printf("samples      %zu (%.1f MS/s analysed)\n", cap.size(),
+                    secs > 0 ? cap.size() / secs * 1e-6 : 0.0);
+        std::printf("clipped      %llu\n", static_cast<unsigned long long>(link.clipped()));
+        if (!link.locked()) {
+            std::printf("no TX->RX alignment found\n");
+            return 1;
+        }
+        double ber_lo, ber_hi, ser_lo, ser_hi;
+        wilson_interval(link.bit_errors(), link.bits(), 1.96, ber_lo, ber_hi);
+        wilson_interval(link.symbol_errors(), link.symbols(), 1.96, ser_lo, ser_hi);
+        std::printf("lag          %zu samples, phase %.3f rad, dc (%.1f, %.1f)\n",
+                    link.lag(), link.phase(), link.dc_i(), link.dc_q());
+        std::printf("BER          %.3g (%llu/%llu), 95%% CI [%.3g, %.3g]\n", link.ber(),
+                    static_cast<unsigned long long>(link.bit_errors()),
+                    static_cast<unsigned long long>(link.bits()), ber_lo, ber_hi);
+        std::printf("SER          %.3g (%llu/%llu), 95%% CI [%.3g, %.3g]\n", link.ser(),
+                    static_cast<unsigned long long>(link.symbol_errors()),
+                    static_cast<unsigned long long>(link.symbols()), ser_lo, ser_hi);
+        std::printf("SNR          %.2f dB, EVM %.2f%%\n", link.snr_db(), 100.0 * link.evm_rms());
+        return 0;
+    }
+    if (cmd == "constellation") {
+        if (argc < 4) usage();
+        unsigned bits = 8, threads = default_threads();
+        for (int a = 4; a < argc; ++a) {
+            const std::string arg = argv[a];
+            if (arg == "--bits" && a + 1 < argc)         bits = static_cast<unsigned>(std::atoi(argv[++a]));
+            else if (arg == "--threads" && a + 1 < argc) threads = static_cast<unsigned>(std::atoi(argv[++a]));
+            else usage();
+        }
+        if (bits < 1 || bits > 12 || threads == 0) usage();
+        MappedCapture cap;
+        const std::string err = cap.open(argv[2]);
+        if (!err.empty()) fatal(err);
+
+        const uint64_t t0 = mono_ns();
+        std::vector<IqHistogram> part(threads, IqHistogram(bits));
+        auto work = [&](unsigned t) {
+            const size_t first = cap.size() * t / threads;
+            const IqSpan s = cap.span(first, cap.size() * (t + 1) / threads - first);
+            part[t].add_interleaved(s.iq, s.n);
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; ++t) pool.emplace_back(work, t);
+        work(0);
+        for (std::thread& th : pool) th.join();
+        for (unsigned t = 1; t < threads; ++t) part[0].merge(part[t]);
+        const double secs = (mono_ns() - t0) * 1e-9;
+
+        if (!part[0].write(argv[3])) fatal(std::string("cannot write ") + argv[3]);
+        std::printf("Wrote %s: %zux%zu bins over %llu samples (%.1f MS/s, %u threads).\n", argv[3],
+                    part[0].side(), part[0].side(), static_cast<unsigned long long>(part[0].total()),
+                    secs > 0 ? part[0].total() / secs * 1e-6 : 0.0, threads);
+        return 0;
+    }
+    if (cmd == "live") {
+        double seconds = 0;
+        std::string hist_path;
+        for (int a = 3; a < argc; ++a) {
+            const std::string arg = argv[a];
+            if (arg == "--seconds" && a + 1 < argc)            seconds = std::atof(argv[++a]);
+            else if (arg == "--constellation" && a + 1 < argc) hist_path = argv[++a];
+            else usage();
+        }
+        ShmRingReader ring;
+        const std::string err = ring.open(argv[2]);
+        if (!err.empty()) fatal(err);
+        std::printf("Attached to %s: %zu-sample ring, %.0f Hz at %.0f Hz, writer pid %u\n", argv[2],
+                    ring.capacity(), ring.header().sample_rate, ring.header().center_hz,
+                    ring.header().writer_pid);
+
+        IqHistogram hist, span_hist;
+        const uint64_t t0 = mono_ns();
+        uint64_t t_line = t0, got = 0, lost_before = 0;
+        double energy = 0;
+        for (;;) {
+            const bool closed = ring.closed();
+            double e = 0;
+            const size_t n = ring.read([&](const IqSpan& s, uint64_t) {
+                for (size_t k = 0; k < s.n; ++k) e += double(s.i(k)) * s.i(k) + double(s.q(k)) * s.q(k);
+                if (!hist_path.empty()) span_hist.add_interleaved(s.iq, s.n);
+            });
+            // Samples overwritten while they were read were counted lost;
+            // their energy and histogram counts are dropped with them
+            if (n) { got += n; energy += e; }
+            if (span_hist.total()) {
+                if (n) hist.merge(span_hist);
+                span_hist.clear();
+            }
+            const uint64_t now = mono_ns();
+            if (now - t_line >= 1000000000 || closed) {
+                const double dt = (now - t_line) * 1e-9;
+                const double level = got ? 10 * std::log10(energy / got / (2048.0 * 2048.0)) : -INFINITY;
+                std::printf("%7.1f s  %6.2f MS/s  level %6.1f dBFS  lost %llu\n", (now - t0) * 1e-9,
+                            got / dt * 1e-6, level,
+                            static_cast<unsigned long long>(ring.lost() - lost_before));
+                std::fflush(stdout);
+                t_line = now;
+                got = 0;
+                energy = 0;
+                lost_before = ring.lost();
+            }
+            if (closed || (seconds > 0 && (now - t0) * 1e-9 >= seconds)) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        if (!hist_path.empty()) {
+            if (!hist.write(hist_path)) fatal("cannot write " + hist_path);
+            std::printf("Wrote %s over %llu samples.\n", hist_path.c_str(),
+                        static_cast<unsigned long long>(hist.total()));
+        }
+        std::printf("%s after sample %llu, %llu samples lost in total.\n",
+                    ring.closed() ? "Stream ended" : "Detached",
+                    static_cast<unsigned long long>(ring.next()), static_cast<unsigned long long>(ring.lost()));
+        return 0;
+    }
+    usage();
+}
@@ -0,0 +1,361 @@
+// Lossless capture encoding for AD9361 samples (12 bits in int16). A capture
+// file is a header followed by self-contained blocks; each block is stored as
+// whichever of these is smaller:
+//   PACK12  two 12-bit values in three bytes, always 75% of int16
+//   RICE    per plane (I, then Q) and per 32-sample group, either no
+//           prediction or the previous sample, then Rice codes of the
+//           zigzagged residuals; out-of-range values use an escape code
+// Every block starts from zero state, so blocks decode independently.
+//
+// Version 2 files end in an index: one IndexEntry per block (file offset,
+// first sample number, wall-clock time of that sample), then a fixed-size
+// IndexFooter. A reader seeks by sample or time with a binary search over
+// the index; a file without one (version 1, or a recording cut short)
+// can still be indexed by walking the block headers.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "seqfile.hpp"
+#include "stream.hpp"
+
+constexpr uint32_t CAPTURE_MAGIC         = 0x50414342;   // "BCAP"
+constexpr uint32_t CAPTURE_VERSION       = 2;
+constexpr uint32_t BLOCK_MAGIC           = 0x4b4c4243;   // "CBLK"
+constexpr uint32_t INDEX_MAGIC           = 0x58444942;   // "BIDX"
+constexpr size_t   CAPTURE_BLOCK_SAMPLES = 65536;
+
+enum BlockCodec : uint8_t { CODEC_PACK12 = 0, CODEC_RICE = 1 };
+
+struct CaptureFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_samples;   // samples per block (the last one may be short)
+    uint32_t reserved;
+};
+
+struct BlockHeader {
+    uint32_t magic;
+    uint8_t  codec;
+    uint8_t  reserved[3];
+    uint32_t nsamples;
+    uint32_t payload_bytes;
+};
+
+struct IndexEntry {
+    uint64_t offset;          // of the BlockHeader, from the start of the file
+    uint64_t first_sample;
+    int64_t  unix_ns;         // wall-clock arrival of first_sample, 0 = unknown
+};
+
+struct IndexFooter {
+    uint64_t index_offset;    // of the first IndexEntry
+    uint64_t entries;
+    uint64_t samples;
+    double   sample_rate;     // Hz, 0 = unknown
+    uint32_t reserved;
+    uint32_t magic;           // last, so a reader checks the final 4 bytes
+};
+
+static_assert(sizeof(CaptureFileHeader) == 16 && sizeof(BlockHeader) == 16, "on-disk layout");
+static_assert(sizeof(IndexEntry) == 24 && sizeof(IndexFooter) == 40, "on-disk layout");
+
+namespace codec_detail {
+
+constexpr size_t   RICE_GROUP = 32;
+constexpr unsigned ESCAPE_Q   = 20;   // unary prefix that announces a raw value
+constexpr unsigned RAW_BITS   = 17;   // zigzag of a first-order residual of int16
+
+inline uint32_t zigzag(int32_t v)   { return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31); }
+inline int32_t  unzigzag(uint32_t u) { return static_cast<int32_t>(u >> 1) ^ -static_cast<int32_t>(u & 1); }
+
+// LSB-first bit packer into a caller-sized buffer.
+class BitWriter {
+public:
+    explicit BitWriter(uint8_t* out) : p_(out), start_(out) {}
+    void put(uint32_t v, unsigned bits) {     // bits <= 32
+        acc_ |= static_cast<uint64_t>(v) << n_;
+        n_ += bits;
+        while (n_ >= 8) { *p_++ = static_cast<uint8_t>(acc_); acc_ >>= 8; n_ -= 8; }
+    }
+    size_t finish() {
+        if (n_ > 0) *p_++ = static_cast<uint8_t>(acc_);
+        acc_ = 0; n_ = 0;
+        return static_cast<size_t>(p_ - start_);
+    }
+private:
+    uint8_t* p_;
+    uint8_t* start_;
+    uint64_t acc_ = 0;
+    unsigned n_ = 0;
+};
+
+// Reads past the end as zeros and remembers that it did.
+class BitReader {
+public:
+    BitReader(const uint8_t* in, size_t size) : p_(in), end_(in + size) {}
+    uint32_t get(unsigned bits) {
+        fill();
+        const uint32_t v = static_cast<uint32_t>(acc_ & ((1ull << bits) - 1));
+        acc_ >>= bits; n_ -= bits;
+        return v;
+    }
+    // Counts leading one bits up to `limit` (at most 57), consuming them and
+    // the zero that ends them (if the run stopped before the limit).
+    unsigned ones(unsigned limit) {
+        fill();
+        const uint64_t zeros = ~acc_;   // 0 when a corrupt block has 64 one bits
+        const unsigned q = zeros ? static_cast<unsigned>(__builtin_ctzll(zeros)) : 64;
+        if (q >= limit) { acc_ >>= limit; n_ -= limit; return limit; }
+        acc_ >>= q + 1; n_ -= q + 1;
+        return q;
+    }
+    bool overrun() const { return over_ > 0 && static_cast<unsigned>(over_) * 8 > n_; }
+private:
+    void fill() {
+        while (n_ <= 56) {
+            uint64_t b = 0;
+            if (p_ < end_) b = *p_++; else over_++;
+            acc_ |= b << n_;
+            n_ += 8;
+        }
+    }
+    const uint8_t* p_;
+    const uint8_t* end_;
+    uint64_t acc_ = 0;
+    unsigned n_ = 0;
+    int      over_ = 0;
+};
+
+inline void rice_encode_plane(const int16_t* x, size_t n, BitWriter& bw) {
+    int32_t prev = 0;
+    for (size_t g = 0; g < n; g += RICE_GROUP) {
+        const size_t m = (n - g < RICE_GROUP) ? n - g : RICE_GROUP;
+        uint64_t sum0 = 0, sum1 = 0;
+        int32_t p = prev;
+        for (size_t k = 0; k < m; ++k) {
+            sum0 += zigzag(x[g + k]);
+            sum1 += zigzag(x[g + k] - p);
+            p = x[g + k];
+        }
+        const bool delta = sum1 < sum0;
+        const uint64_t sum = delta ? sum1 : sum0;
+        unsigned kbits = 0;
+        while (kbits < 15 && (static_cast<uint64_t>(m) << (kbits + 1)) <= sum) ++kbits;
+        bw.put((delta ? 16u : 0u) | kbits, 5);
+        for (size_t k = 0; k < m; ++k) {
+            const uint32_t u = zigzag(delta ? x[g + k] - prev : x[g + k]);
+            prev = x[g + k];
+            const uint32_t q = u >> kbits;
+            if (q < ESCAPE_Q) {
+                bw.put((1u << q) - 1, q + 1);          // q ones, then a zero
+                bw.put(u & ((1u << kbits) - 1), kbits);
+            } else {
+                bw.put((1u << ESCAPE_Q) - 1, ESCAPE_Q);
+                bw.put(u, RAW_BITS);
+            }
+        }
+    }
+}
+
+inline bool rice_decode_plane(BitReader& br, size_t n, int16_t* x) {
+    int32_t prev = 0;
+    for (size_t g = 0; g < n; g += RICE_GROUP) {
+        const size_t m = (n - g < RICE_GROUP) ? n - g : RICE_GROUP;
+        if (br.overrun()) return false;   // truncated block: stop at the first group past its end
+        const uint32_t hdr = br.get(5);
+        const bool delta = hdr & 16u;
+        const unsigned kbits = hdr & 15u;
+        for (size_t k = 0; k < m; ++k) {
+            const unsigned q = br.ones(ESCAPE_Q);
+            const uint32_t u = (q == ESCAPE_Q) ? br.get(RAW_BITS) : (q << kbits) | br.get(kbits);
+            const int32_t v = unzigzag(u) + (delta ? prev : 0);
+            if (v < INT16_MIN || v > INT16_MAX) return false;
+            x[g + k] = static_cast<int16_t>(v);
+            prev = v;
+        }
+    }
+    return !br.overrun();
+}
+
+} // namespace codec_detail
+
+// Upper bound of an encoded block (header included) of n samples.
+inline size_t max_block_bytes(size_t n) {
+    const size_t groups = (n + codec_detail::RICE_GROUP - 1) / codec_detail::RICE_GROUP;
+    const size_t rice_bits = 2 * (n * (codec_detail::ESCAPE_Q + codec_detail::RAW_BITS) + groups * 5);
+    const size_t rice = rice_bits / 8 + 2;
+    return sizeof(BlockHeader) + (rice > 3 * n ? rice : 3 * n);
+}
+
+// Encodes n samples into `out` (room for max_block_bytes(n)). Returns the
+// bytes written, header included.
+inline size_t encode_block(const int16_t* i, const int16_t* q, size_t n, uint8_t* out) {
+    using namespace codec_detail;
+    BlockHeader h{};
+    h.magic = BLOCK_MAGIC;
+    h.nsamples = static_cast<uint32_t>(n);
+    uint8_t* payload = out + sizeof(BlockHeader);
+
+    BitWriter bw(payload);
+    rice_encode_plane(i, n, bw);
+    rice_encode_plane(q, n, bw);
+    size_t bytes = bw.finish();
+    h.codec = CODEC_RICE;
+
+    bool fits12 = true;
+    for (size_t k = 0; k < n && fits12; ++k)
+        fits12 = i[k] >= -2048 && i[k] <= 2047 && q[k] >= -2048 && q[k] <= 2047;
+    if (fits12 && 3 * n <= bytes) {
+        uint8_t* p = payload;
+        for (size_t k = 0; k < n; ++k, p += 3) {
+            const uint16_t a = static_cast<uint16_t>(i[k]) & 0xfff;
+            const uint16_t b = static_cast<uint16_t>(q[k]) & 0xfff;
+            p[0] = static_cast<uint8_t>(a);
+            p[1] = static_cast<uint8_t>((a >> 8) | (b << 4));
+            p[2] = static_cast<uint8_t>(b >> 4);
+        }
+        bytes = 3 * n;
+        h.codec = CODEC_PACK12;
+    }
+    h.payload_bytes = static_cast<uint32_t>(bytes);
+    std::memcpy(out, &h, sizeof(h));
+    return sizeof(h) + bytes;
+}
+
+// Decodes one block from [in, in + avail) into i/q (room for max_n).
+// Returns the bytes consumed, or 0 if the block is truncated or corrupt.
+inline size_t decode_block(const uint8_t* in, size_t avail, int16_t* i, int16_t* q,
+                           size_t max_n, size_t& n) {
+    using namespace codec_detail;
+    BlockHeader h;
+    if (avail < sizeof(h)) return 0;
+    std::memcpy(&h, in, sizeof(h));
+    if (h.magic != BLOCK_MAGIC || h.nsamples > max_n ||
+        h.payload_bytes > avail - sizeof(h)) return 0;
+    const uint8_t* payload = in + sizeof(h);
+    n = h.nsamples;
+    if (h.codec == CODEC_PACK12) {
+        if (h.payload_bytes != 3 * n) return 0;
+        const uint8_t* p = payload;
+        for (size_t k = 0; k < n; ++k, p += 3) {
+            const uint16_t a = static_cast<uint16_t>(p[0] | ((p[1] & 0x0f) << 8));
+            const uint16_t b = static_cast<uint16_t>((p[1] >> 4) | (p[2] << 4));
+            i[k] = static_cast<int16_t>(static_cast<int16_t>(a << 4) >> 4);   // sign-extend 12 bits
+            q[k] = static_cast<int16_t>(static_cast<int16_t>(b << 4) >> 4);
+        }
+    } else if (h.codec == CODEC_RICE) {
+        BitReader br(payload, h.payload_bytes);
+        if (!rice_decode_plane(br, n, i) || !rice_decode_plane(br, n, q)) return 0;
+    } else {
+        return 0;
+    }
+    return sizeof(h) + h.payload_bytes;
+}
+
+// ---------- Packed capture writer ----------
+// Collects RX samples into blocks and appends them encoded, then the index
+// on close(). Runs on the recorder thread; the block buffers are allocated
+// in open(), the index grows by one entry per block.
+class CaptureWriter : public SampleSink {
+public:
+    std::string open(const std::string& path, double sample_rate = 0,
+                     size_t block_samples = CAPTURE_BLOCK_SAMPLES) {
+        block_ = block_samples;
+        rate_ = sample_rate;
+        i_.assign(block_, 0);
+        q_.assign(block_, 0);
+        fill_ = 0;
+        samples_ = 0;
+        flushed_ = 0;
+        blocks_[0] = blocks_[1] = 0;
+        index_.clear();
+        stamped_ = 0;
+        anchor_sample_ = 0;
+        anchor_ns_ = 0;
+        const std::string err = file_.open(path);
+        if (!err.empty()) return err;
+        const CaptureFileHeader h{CAPTURE_MAGIC, CAPTURE_VERSION, static_cast<uint32_t>(block_), 0};
+        file_.append(&h, sizeof(h));
+        return "";
+    }
+
+    void write(const int16_t* i, const int16_t* q, size_t n) override {
+        samples_ += n;
+        while (n > 0) {
+            const size_t k = std::min(n, block_ - fill_);
+            std::memcpy(i_.data() + fill_, i, k * sizeof(int16_t));
+            std::memcpy(q_.data() + fill_, q, k * sizeof(int16_t));
+            fill_ += k;
+            i += k; q += k; n -= k;
+            if (fill_ == block_) flush_block();
+        }
+    }
+
+    // Block start times are extrapolated at the sample rate from the first
+    // mark after the block was written.
+    void mark_time(uint64_t sample, int64_t unix_ns) override {
+        anchor_sample_ = sample;
+        anchor_ns_ = unix_ns;
+        stamp_blocks();
+    }
+
+    // Encodes the partial last block, appends the index and closes the file.
+    std::string close() {
+        if (fill_ > 0) flush_block();
+        stamp_blocks();
+        IndexFooter f{};
+        f.index_offset = file_.offset();
+        f.entries = index_.size();
+        f.samples = samples_;
+        f.sample_rate = rate_;
+        f.magic = INDEX_MAGIC;
+        file_.append(index_.data(), index_.size() * sizeof(IndexEntry));
+        file_.append(&f, sizeof(f));
+        return file_.close();
+    }
+
+    uint64_t samples()       const { return samples_; }
+    uint64_t bytes()         const { return file_.offset(); }
+    uint64_t pack12_blocks() const { return blocks_[CODEC_PACK12]; }
+    uint64_t rice_blocks()   const { return blocks_[CODEC_RICE]; }
+
+private:
+    void flush_block() {
+        index_.push_back({file_.offset(), flushed_, 0});
+        flushed_ += fill_;
+        uint8_t* out = file_.reserve(max_block_bytes(fill_));
+        const size_t bytes = encode_block(i_.data(), q_.data(), fill_, out);
+        BlockHeader h;
+        std::memcpy(&h, out, sizeof(h));
+        blocks_[h.codec]++;
+        file_.commit(bytes);
+        fill_ = 0;
+    }
+
+    void stamp_blocks() {
+        if (anchor_ns_ == 0 || rate_ <= 0) return;
+        for (; stamped_ < index_.size(); ++stamped_) {
+            const double dt = (static_cast<double>(index_[stamped_].first_sample) -
+                               static_cast<double>(anchor_sample_)) / rate_;
+            index_[stamped_].unix_ns = anchor_ns_ + static_cast<int64_t>(dt * 1e9);
+        }
+    }
+
+    SeqFile                 file_;
+    std::vector<int16_t>    i_, q_;
+    size_t                  block_ = 0, fill_ = 0;
+    double                  rate_ = 0;
+    uint64_t                samples_ = 0;
+    uint64_t                flushed_ = 0;          // samples in written blocks
+    uint64_t                blocks_[2] = {0, 0};
+    std::vector<IndexEntry> index_;
+    size_t                  stamped_ = 0;          // index_[0, stamped_) have times
+    uint64_t                anchor_sample_ = 0;
+    int64_t                 anchor_ns_ = 0;
+};
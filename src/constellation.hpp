@@ -0,0 +1,168 @@
+// Constellation density: a fixed 2D histogram over the 12-bit I/Q plane,
+// filled per RX block and written as a small .npy array or PNG heatmap, so
+// plotting costs the same whatever the capture length. A histogram is
+// owned by one thread; parallel passes fill one each and merge() them.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class IqHistogram {
+public:
+    static constexpr int ADC_MIN = -2048, ADC_MAX = 2047;
+
+    // 2^bits bins per axis, bits in [1, 12].
+    explicit IqHistogram(unsigned bits = 8)
+        : shift_(12 - bits), side_(size_t(1) << bits), counts_(side_ * side_, 0) {}
+
+    void add(const int16_t* i, const int16_t* q, size_t n) { add_strided(i, q, n, 1); }
+    // Interleaved [I0 Q0 I1 Q1 ...], e.g. a MappedCapture span.
+    void add_interleaved(const int16_t* iq, size_t n) { add_strided(iq, iq + 1, n, 2); }
+
+    void merge(const IqHistogram& o) {
+        for (size_t k = 0; k < counts_.size() && k < o.counts_.size(); ++k) counts_[k] += o.counts_[k];
+        total_ += o.total_;
+    }
+
+    void clear() {
+        std::fill(counts_.begin(), counts_.end(), 0);
+        total_ = 0;
+    }
+
+    size_t   side()  const { return side_; }
+    uint64_t total() const { return total_; }
+    // Row = Q bin, column = I bin, both from the most negative value up.
+    uint64_t at(size_t row, size_t col) const { return counts_[row * side_ + col]; }
+
+    // PNG for a .png path, else .npy.
+    bool write(const std::string& path) const {
+        const bool png = path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0;
+        return png ? write_png(path) : write_npy(path);
+    }
+
+    // NumPy .npy, uint64 [side, side] indexed [q_bin, i_bin].
+    bool write_npy(const std::string& path) const {
+        std::FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f) return false;
+        std::string dict = "{'descr': '<u8', 'fortran_order': False, 'shape': (" +
+                           std::to_string(side_) + ", " + std::to_string(side_) + "), }";
+        const size_t PREAMBLE = 10;   // magic, version, header length
+        dict.append(63 - (PREAMBLE + dict.size()) % 64, ' ');
+        dict += '\n';
+        const uint8_t pre[PREAMBLE] = {0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0,
+                                       uint8_t(dict.size() & 0xff), uint8_t(dict.size() >> 8)};
+        bool ok = std::fwrite(pre, 1, PREAMBLE, f) == PREAMBLE &&
+                  std::fwrite(dict.data(), 1, dict.size(), f) == dict.size() &&
+                  std::fwrite(counts_.data(), sizeof(uint64_t), counts_.size(), f) == counts_.size();
+        return std::fclose(f) == 0 && ok;
+    }
+
+    // 8-bit grayscale PNG, log-scaled counts, +Q at the top.
+    bool write_png(const std::string& path) const {
+        const uint64_t peak = *std::max_element(counts_.begin(), counts_.end());
+        const double scale = peak ? 255.0 / std::log1p(static_cast<double>(peak)) : 0.0;
+        std::vector<uint8_t> pixels(side_ * side_);
+        for (size_t row = 0; row < side_; ++row)
+            for (size_t col = 0; col < side_; ++col)
+                pixels[(side_ - 1 - row) * side_ + col] = static_cast<uint8_t>(
+                    std::lround(scale * std::log1p(static_cast<double>(at(row, col)))));
+        return write_gray_png(path, side_, side_, pixels.data());
+    }
+
+private:
+    template <class T> void add_strided(const T* i, const T* q, size_t n, size_t stride) {
+        const size_t CHUNK = 256;
+        uint32_t idx[CHUNK];
+        const size_t side = side_;
+        const unsigned shift = shift_;
+        for (size_t base = 0; base < n; base += CHUNK) {
+            const size_t m = std::min(CHUNK, n - base);
+            const T* pi = i + base * stride;
+            const T* pq = q + base * stride;
+            // Index computation vectorizes; the increments stay scalar
+            for (size_t k = 0; k < m; ++k) {
+                const int vi = std::min(std::max(int(pi[k * stride]), ADC_MIN), ADC_MAX) - ADC_MIN;
+                const int vq = std::min(std::max(int(pq[k * stride]), ADC_MIN), ADC_MAX) - ADC_MIN;
+                idx[k] = static_cast<uint32_t>((vq >> shift) * side + (vi >> shift));
+            }
+            for (size_t k = 0; k < m; ++k) counts_[idx[k]]++;
+        }
+        total_ += n;
+    }
+
+    static uint32_t crc32(const uint8_t* p, size_t n, uint32_t crc = 0) {
+        static const std::array<uint32_t, 256> table = [] {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t k = 0; k < 256; ++k) {
+                uint32_t c = k;
+                for (int b = 0; b < 8; ++b) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                t[k] = c;
+            }
+            return t;
+        }();
+        crc = ~crc;
+        for (size_t k = 0; k < n; ++k) crc = table[(crc ^ p[k]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    // PNG with the image data in stored (uncompressed) deflate blocks.
+    static bool write_gray_png(const std::string& path, size_t w, size_t h, const uint8_t* pixels) {
+        std::vector<uint8_t> raw;                    // filter byte 0, then the row
+        for (size_t y = 0; y < h; ++y) {
+            raw.push_back(0);
+            raw.insert(raw.end(), pixels + y * w, pixels + (y + 1) * w);
+        }
+        std::vector<uint8_t> z = {0x78, 0x01};
+        const size_t MAX_STORED = 65535;
+        for (size_t off = 0; off < raw.size(); off += MAX_STORED) {
+            const size_t len = std::min(MAX_STORED, raw.size() - off);
+            const bool last = off + len == raw.size();
+            z.push_back(last ? 1 : 0);
+            z.push_back(uint8_t(len));
+            z.push_back(uint8_t(len >> 8));
+            z.push_back(uint8_t(~len));
+            z.push_back(uint8_t(~len >> 8));
+            z.insert(z.end(), raw.begin() + off, raw.begin() + off + len);
+        }
+        uint32_t a = 1, b = 0;                       // Adler-32
+        for (uint8_t v : raw) { a = (a + v) % 65521; b = (b + a) % 65521; }
+        put_be32(z, (b << 16) | a);
+
+        std::vector<uint8_t> ihdr;
+        put_be32(ihdr, static_cast<uint32_t>(w));
+        put_be32(ihdr, static_cast<uint32_t>(h));
+        ihdr.insert(ihdr.end(), {8, 0, 0, 0, 0});    // 8-bit grayscale, no interlace
+
+        std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        put_chunk(png, "IHDR", ihdr);
+        put_chunk(png, "IDAT", z);
+        put_chunk(png, "IEND", {});
+        std::FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f) return false;
+        const bool ok = std::fwrite(png.data(), 1, png.size(), f) == png.size();
+        return std::fclose(f) == 0 && ok;
+    }
+
+    static void put_be32(std::vector<uint8_t>& out, uint32_t v) {
+        out.insert(out.end(), {uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v)});
+    }
+
+    static void put_chunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+        put_be32(out, static_cast<uint32_t>(data.size()));
+        const size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        put_be32(out, crc32(out.data() + start, out.size() - start));
+    }
+
+    unsigned              shift_;
+    size_t                side_;
+    std::vector<uint64_t> counts_;
+    uint64_t              total_ = 0;
+};
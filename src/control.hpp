@@ -0,0 +1,123 @@
+// Control socket of the measurement daemon: a Unix stream socket on which
+// each request is one line of text and each reply one line (JSON, by the
+// daemon's convention). Clients are served one at a time on the calling
+// thread, so requests never overlap a measurement; a client may keep its
+// connection open and send any number of requests.
+#pragma once
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+class ControlServer {
+public:
+    ControlServer() = default;
+    ~ControlServer() { close(); }
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+    // Listens on `path`, replacing a stale socket left by a daemon that
+    // died. Returns an empty string on success or what failed.
+    std::string listen(const std::string& path) {
+        close();
+        sockaddr_un addr{};
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) return "bad socket path '" + path + "'";
+        struct stat sb{};
+        if (::stat(path.c_str(), &sb) == 0) {
+            if (!S_ISSOCK(sb.st_mode)) return path + " exists and is not a socket";
+            if (in_use(path)) return path + " is in use by another daemon";
+            ::unlink(path.c_str());
+        }
+        fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd_ < 0) return std::string("socket: ") + std::strerror(errno);
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        if (::bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(fd_, 8) < 0) {
+            const std::string err = "bind " + path + ": " + std::strerror(errno);
+            ::close(fd_);
+            fd_ = -1;
+            return err;
+        }
+        path_ = path;
+        return "";
+    }
+
+    // Serves clients until `stop` is set or handle() returns false.
+    // handle(const std::string& request, std::string& reply) gets each
+    // request line without its newline and fills the reply, which is sent
+    // with a newline appended.
+    template <class Handler> void serve(Handler handle, const std::atomic<bool>& stop) {
+        bool running = true;
+        while (running && !stop.load()) {
+            pollfd pfd{fd_, POLLIN, 0};
+            if (::poll(&pfd, 1, 200) <= 0) continue;
+            const int c = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (c < 0) continue;
+            std::string in, reply;
+            char buf[4096];
+            while (running && !stop.load()) {
+                size_t nl;
+                while (running && (nl = in.find('\n')) != std::string::npos) {
+                    std::string line = in.substr(0, nl);
+                    in.erase(0, nl + 1);
+                    if (!line.empty() && line.back() == '\r') line.pop_back();
+                    if (line.empty()) continue;
+                    reply.clear();
+                    running = handle(line, reply);
+                    reply += '\n';
+                    if (!send_all(c, reply)) break;   // the next recv() sees the hang-up
+                }
+                if (!running) break;
+                pollfd cp{c, POLLIN, 0};
+                if (::poll(&cp, 1, 200) <= 0) continue;
+                const ssize_t n = ::recv(c, buf, sizeof(buf), 0);
+                if (n <= 0) break;
+                in.append(buf, static_cast<size_t>(n));
+                if (in.size() > MAX_REQUEST && in.find('\n') == std::string::npos) break;
+            }
+            ::close(c);
+        }
+    }
+
+    void close() {
+        if (fd_ < 0) return;
+        ::close(fd_);
+        ::unlink(path_.c_str());
+        fd_ = -1;
+    }
+
+private:
+    static constexpr size_t MAX_REQUEST = 1 << 16;
+
+    static bool send_all(int c, const std::string& s) {
+        size_t off = 0;
+        while (off < s.size()) {
+            const ssize_t n = ::send(c, s.data() + off, s.size() - off, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            off += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // A live daemon accepts connections; a stale socket file refuses them.
+    static bool in_use(const std::string& path) {
+        const int s = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (s < 0) return false;
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        const bool live = ::connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        ::close(s);
+        return live;
+    }
+
+    int         fd_ = -1;
+    std::string path_;
+};
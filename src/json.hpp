@@ -0,0 +1,111 @@
+// Streaming JSON writer for the run report and other machine-readable
+// output. Emits pretty-printed objects and arrays straight to an ostream,
+// or with `compact` everything on one line (for line-based protocols);
+// non-finite numbers become null.
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+class JsonWriter {
+public:
+    explicit JsonWriter(std::ostream& os, bool compact = false) : os_(os), compact_(compact) {}
+
+    // key is required inside objects and ignored inside arrays / at top level.
+    JsonWriter& begin_object(const char* key = nullptr) { open(key, '{'); return *this; }
+    JsonWriter& end_object()                            { close('}'); return *this; }
+    JsonWriter& begin_array(const char* key = nullptr)  { open(key, '['); return *this; }
+    JsonWriter& end_array()                             { close(']'); return *this; }
+
+    JsonWriter& field(const char* key, const std::string& v) { prefix(key); quote(v); return *this; }
+    JsonWriter& field(const char* key, const char* v)        { prefix(key); quote(v); return *this; }
+    JsonWriter& field(const char* key, bool v) {
+        prefix(key);
+        os_ << (v ? "true" : "false");
+        return *this;
+    }
+    JsonWriter& field(const char* key, double v) {
+        prefix(key);
+        if (!std::isfinite(v)) { os_ << "null"; return *this; }
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.10g", v);
+        os_ << buf;
+        return *this;
+    }
+    template <class T, class = std::enable_if_t<std::is_integral<T>::value>>
+    JsonWriter& field(const char* key, T v) {
+        prefix(key);
+        os_ << +v;
+        return *this;
+    }
+    JsonWriter& null(const char* key) { prefix(key); os_ << "null"; return *this; }
+
+    // Array elements.
+    template <class T> JsonWriter& value(const T& v) { return field(nullptr, v); }
+
+    // Terminates the document with a newline once the outermost value closed.
+    void finish() { os_ << "\n"; }
+
+private:
+    void indent() {
+        if (compact_) return;
+        for (size_t k = 0; k < first_.size(); ++k) os_ << "  ";
+    }
+    void prefix(const char* key) {
+        if (!first_.empty()) {
+            if (!first_.back()) os_ << ',';
+            if (!compact_) os_ << '\n';
+            first_.back() = false;
+            indent();
+            if (key && in_object_.back()) {
+                quote(key);
+                os_ << (compact_ ? ":" : ": ");
+            }
+        }
+    }
+    void open(const char* key, char c) {
+        prefix(key);
+        os_ << c;
+        first_.push_back(true);
+        in_object_.push_back(c == '{');
+    }
+    void close(char c) {
+        const bool empty = first_.back();
+        first_.pop_back();
+        in_object_.pop_back();
+        if (!empty && !compact_) {
+            os_ << "\n";
+            indent();
+        }
+        os_ << c;
+    }
+    void quote(const std::string& s) {
+        os_ << '"';
+        for (char ch : s) {
+            switch (ch) {
+            case '"':  os_ << "\\\""; break;
+            case '\\': os_ << "\\\\"; break;
+            case '\n': os_ << "\\n";  break;
+            case '\t': os_ << "\\t";  break;
+            default:
+                if (static_cast<unsigned char>(ch) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", ch);
+                    os_ << buf;
+                } else {
+                    os_ << ch;
+                }
+            }
+        }
+        os_ << '"';
+    }
+
+    std::ostream&     os_;
+    bool              compact_;
+    std::vector<bool> first_;       // nothing written yet at this depth
+    std::vector<bool> in_object_;   // depth is an object (vs array)
+};
@@ -0,0 +1,107 @@
+// Fixed-size log-linear latency histogram (HDR-style) for per-call timing of
+// blocking libiio calls. record() is a handful of integer ops on a static
+// array: no allocation, no locking, safe to call on the streaming path.
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+
+class LatencyHistogram {
+public:
+    // 2^SUB_BITS linear sub-buckets per power of two -> worst-case relative
+    // error of 1/32 (~3%) on any reported percentile.
+    static constexpr int      SUB_BITS = 5;
+    static constexpr uint64_t SUB      = 1ull << SUB_BITS;
+    static constexpr size_t   NBUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    void record(uint64_t ns) {
+        counts_[index_of(ns)]++;
+        count_++;
+        sum_ += ns;
+        if (ns > max_) max_ = ns;
+    }
+
+    void reset() { *this = LatencyHistogram(); }
+
+    uint64_t count() const { return count_; }
+    uint64_t max()   const { return max_; }
+    uint64_t total() const { return sum_; }
+    double   mean()  const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+
+    // Upper bound (ns) of the bucket holding the q-quantile, q in [0,1].
+    uint64_t percentile(double q) const {
+        if (count_ == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count_) + 0.5);
+        if (rank < 1) rank = 1;
+        if (rank > count_) rank = count_;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < NBUCKETS; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                const uint64_t hi = upper_of(i);
+                return hi < max_ ? hi : max_;
+            }
+        }
+        return max_;
+    }
+
+    // One line: "name  n=... p50=...us p99=...us p99.9=...us max=...us"
+    void print_summary(std::ostream& os, const char* name) const {
+        char line[192];
+        std::snprintf(line, sizeof(line),
+                      "%-18s n=%-8llu p50=%9.1fus p99=%9.1fus p99.9=%9.1fus max=%9.1fus",
+                      name, static_cast<unsigned long long>(count_),
+                      percentile(0.50) * 1e-3, percentile(0.99) * 1e-3,
+                      percentile(0.999) * 1e-3, max_ * 1e-3);
+        os << line << "\n";
+    }
+
+private:
+    static size_t index_of(uint64_t v) {
+        if (v < SUB) return static_cast<size_t>(v);
+        const int msb   = 63 - __builtin_clzll(v);
+        const int shift = msb - SUB_BITS;
+        const uint64_t sub = v >> shift;               // in [SUB, 2*SUB)
+        return static_cast<size_t>((shift + 1) * SUB + (sub - SUB));
+    }
+
+    static uint64_t upper_of(size_t i) {
+        if (i < SUB) return i;
+        const int shift = static_cast<int>(i / SUB) - 1;
+        const uint64_t sub = i % SUB + SUB;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::array<uint64_t, NBUCKETS> counts_{};
+    uint64_t count_ = 0;
+    uint64_t sum_   = 0;
+    uint64_t max_   = 0;
+};
+
+// Monotonic nanosecond timestamp for latency measurements.
+inline uint64_t mono_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Wall-clock nanoseconds since the Unix epoch, for timestamps kept in files.
+inline int64_t wall_ns() {
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// Adds the time spent in the enclosing scope to `total_ns`.
+class StageTimer {
+public:
+    explicit StageTimer(uint64_t& total_ns) : total_(total_ns), t0_(mono_ns()) {}
+    ~StageTimer() { total_ += mono_ns() - t0_; }
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    uint64_t& total_;
+    uint64_t  t0_;
+};
@@ -1,20 +1,73 @@
 #include <iio.h>
+#include <algorithm>
+#include <cerrno>
+#include <atomic>
+#include <chrono>
+#include <csignal>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <iostream>
+#include <ctime>
 #include <fstream>
+#include <iostream>
+#include <new>
 #include <random>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "analysis.hpp"
+#include "arrow.hpp"
+#include "calibration.hpp"
+#include "campaign.hpp"
+#include "codec.hpp"
+#include "constellation.hpp"
+#include "control.hpp"
+#include "latency.hpp"
+#include "json.hpp"
+#include "markers.hpp"
+#include "metrics.hpp"
+#include "pool.hpp"
+#include "psd.hpp"
+#include "rt.hpp"
+#include "shm_ring.hpp"
+#include "sigmf.hpp"
+#include "sim.hpp"
+#include "stream.hpp"
+#include "trace.hpp"
+
 static void fatal(const std::string& msg) {
     std::cerr << "ERROR: " << msg << std::endl;
     std::exit(1);
 }
 
-static void write_attr_ll_dbg(struct iio_channel* ch, const char* attr, long long val) {
-    int ret = iio_channel_attr_write_longlong(ch, attr, val);
+// ---------- Heap allocation counter ----------
+// Every operator new on a thread inside an AllocCounting(true) scope is
+// counted. The streaming loops run counted, so a non-zero count means the
+// steady state touched the heap.
+static std::atomic<uint64_t> g_counted_allocs{0};
+static thread_local bool t_count_allocs = false;
+
+void* operator new(std::size_t size) {
+    if (t_count_allocs) g_counted_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+class AllocCounting {
+public:
+    explicit AllocCounting(bool on) : prev_(t_count_allocs) { t_count_allocs = on; }
+    ~AllocCounting() { t_count_allocs = prev_; }
+private:
+    bool prev_;
+};
+
+static void write_attr_str_dbg(struct iio_channel* ch, const char* attr, const char* val) {
+    int ret = iio_channel_attr_write(ch, attr, val);
     if (ret < 0) {
         char buf[128];
         iio_strerror(-ret, buf, sizeof(buf));
@@ -24,173 +77,1954 @@ static void write_attr_ll_dbg(struct iio_channel* ch, const char* attr, long lon
     }
 }
 
-static void write_attr_str_dbg(struct iio_channel* ch, const char* attr, const char* val) {
-    int ret = iio_channel_attr_write(ch, attr, val);
-    if (ret < 0) {
+// Reads a channel attribute back as text; "" if it can't be read.
+static std::string read_attr_str(const struct iio_channel* ch, const char* attr) {
+    char buf[256];
+    const ssize_t ret = iio_channel_attr_read(ch, attr, buf, sizeof(buf));
+    return ret > 0 ? std::string(buf) : std::string();
+}
+
+// ---------- Attribute cache ----------
+// What each PHY attribute was last set to, so reconfiguring writes only the
+// values that change. Each write is a round trip to the device (a USB or
+// network request), so set() only queues a change and commit() sends the
+// queued changes of one channel together through iio_channel_attr_write_all,
+// which libiio packs into a single request. Attributes of one channel are
+// written in the driver's order, not in the order they were queued: commit
+// between settings that depend on each other.
+class AttrCache {
+public:
+    // Queues attr=val unless val is what was last written. Returns whether
+    // it was queued.
+    bool set(iio_channel* ch, const char* attr, const std::string& val) {
+        Entry& e = entry(ch, attr);
+        if (e.has_written && e.written == val) {
+            skipped_++;
+            return false;
+        }
+        for (Pending& q : pending_)
+            if (q.ch == ch && q.attr == attr) {
+                q.val = val;
+                return true;
+            }
+        pending_.push_back({ch, attr, val});
+        return true;
+    }
+    bool set(iio_channel* ch, const char* attr, long long val) { return set(ch, attr, std::to_string(val)); }
+
+    // Writes what set() queued, one request per channel. Returns how many
+    // requests went out. A failed write exits, as write_attr_*_dbg do.
+    unsigned commit() {
+        unsigned requests = 0;
+        while (!pending_.empty()) {
+            iio_channel* ch = pending_.front().ch;
+            std::vector<Pending> batch;
+            for (auto it = pending_.begin(); it != pending_.end();) {
+                if (it->ch == ch) {
+                    batch.push_back(std::move(*it));
+                    it = pending_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            requests += write(ch, batch);
+            for (const Pending& q : batch) {
+                Entry& e = entry(ch, q.attr.c_str());
+                e.written = q.val;
+                e.has_written = true;
+                writes_++;
+            }
+        }
+        requests_ += requests;
+        return requests;
+    }
+
+    // Reads an attribute from the device and remembers the value; "" if it
+    // can't be read.
+    std::string read(const iio_channel* ch, const char* attr) {
+        std::string val = read_attr_str(ch, attr);
+        entry(ch, attr).read = val;
+        return val;
+    }
+
+    // Last value read back by read(); "" if never read.
+    std::string last_read(const iio_channel* ch, const char* attr) const {
+        const Entry* e = find(ch, attr);
+        return e ? e->read : std::string();
+    }
+
+    // Forgets what was written, e.g. to an attribute the driver now changes
+    // on its own, so the next set() writes it again.
+    void forget(const iio_channel* ch, const char* attr) {
+        if (Entry* e = find(ch, attr)) e->has_written = false;
+    }
+
+    uint64_t writes()   const { return writes_; }     // attribute values written
+    uint64_t requests() const { return requests_; }   // round trips they took
+    uint64_t skipped()  const { return skipped_; }    // set() calls that were no-ops
+
+private:
+    struct Entry {
+        const iio_channel* ch;
+        std::string        attr, written, read;
+        bool               has_written = false;
+    };
+    struct Pending {
+        iio_channel* ch;
+        std::string  attr, val;
+    };
+
+    static unsigned write(iio_channel* ch, const std::vector<Pending>& batch) {
+        if (batch.size() == 1) {
+            write_attr_str_dbg(ch, batch[0].attr.c_str(), batch[0].val.c_str());
+            return 1;
+        }
+        // The callback fills the values being set; returning 0 leaves the
+        // channel's other attributes alone
+        auto fill = [](iio_channel*, const char* attr, void* buf, size_t len, void* d) -> ssize_t {
+            for (const Pending& q : *static_cast<const std::vector<Pending>*>(d))
+                if (q.attr == attr) {
+                    if (q.val.size() + 1 > len) return -ENOSPC;
+                    std::memcpy(buf, q.val.c_str(), q.val.size() + 1);
+                    return static_cast<ssize_t>(q.val.size() + 1);
+                }
+            return 0;
+        };
+        const int ret = iio_channel_attr_write_all(ch, fill, const_cast<std::vector<Pending>*>(&batch));
+        if (ret >= 0) return 1;
+        // Backends without batched writes: one request per attribute
+        if (ret == -ENOSYS) {
+            for (const Pending& q : batch) write_attr_str_dbg(ch, q.attr.c_str(), q.val.c_str());
+            return static_cast<unsigned>(batch.size());
+        }
         char buf[128];
         iio_strerror(-ret, buf, sizeof(buf));
-        std::cerr << "ERROR: write " << attr << "=" << val
-                  << " -> " << buf << " (" << ret << ")\n";
+        std::cerr << "ERROR: write";
+        for (const Pending& q : batch) std::cerr << " " << q.attr << "=" << q.val;
+        std::cerr << " -> " << buf << " (" << ret << ")\n";
         std::exit(1);
     }
+
+    // A dozen or so attributes: a linear search beats any index
+    const Entry* find(const iio_channel* ch, const char* attr) const {
+        for (const Entry& e : entries_)
+            if (e.ch == ch && e.attr == attr) return &e;
+        return nullptr;
+    }
+    Entry* find(const iio_channel* ch, const char* attr) {
+        return const_cast<Entry*>(static_cast<const AttrCache*>(this)->find(ch, attr));
+    }
+    Entry& entry(const iio_channel* ch, const char* attr) {
+        if (Entry* e = find(ch, attr)) return *e;
+        entries_.push_back({ch, attr, "", "", false});
+        return entries_.back();
+    }
+
+    std::vector<Entry>   entries_;
+    std::vector<Pending> pending_;
+    uint64_t             writes_ = 0, requests_ = 0, skipped_ = 0;
+};
+
+// AXI DMAC status register on the ADC/DAC cores; write-1-to-clear.
+// Bit 2 on cf-ad9361-lpc = RX overflow, bit 0 on the DDS core = TX underflow.
+static const uint32_t AXI_STATUS_REG   = 0x80000088;
+static const uint32_t RX_OVERFLOW_BIT  = 1u << 2;
+static const uint32_t TX_UNDERFLOW_BIT = 1u << 0;
+
+// Returns 1 if `mask` was set (and clears it), 0 if not, -1 if the register
+// is not accessible (e.g. no debugfs over this backend).
+static int check_xflow(iio_device* dev, uint32_t mask) {
+    uint32_t val = 0;
+    if (iio_device_reg_read(dev, AXI_STATUS_REG, &val) < 0) return -1;
+    if (!(val & mask)) return 0;
+    iio_device_reg_write(dev, AXI_STATUS_REG, val);
+    return 1;
 }
 
-int main() {
-    // ---------- User settings ----------
-    const char*     URI          = "usb:1.6.5";     // e.g., "usb:1.5.5" or "ip:192.168.2.1"
-    const long long SAMPLE_RATE  = 3840000;         // 3.84 MSPS (supported by DMA cores)
-    const long long RX_LO_HZ     = 2400000000LL;    // 2.4 GHz
-    const long long TX_LO_HZ     = 2400000000LL;    // 2.4 GHz
-    const size_t    NSAMPLES     = 16384;           // complex samples to send/receive
-    const int16_t   AMP          = 100;             // TX symbol amplitude (reduce if RX clips)
-    const std::string CSV_PATH   = "../samples.csv";
+// ---------- Radio: context, devices and channels of one Pluto ----------
+struct Radio {
+    iio_context* ctx = nullptr;
+    iio_device*  phy = nullptr;
+    iio_device*  rx  = nullptr;
+    iio_device*  tx  = nullptr;
+    iio_channel* rx_lo = nullptr;   // PHY altvoltage0
+    iio_channel* tx_lo = nullptr;   // PHY altvoltage1
+    iio_channel* rx_bb = nullptr;   // PHY voltage0 in
+    iio_channel* tx_bb = nullptr;   // PHY voltage0 out
+    iio_channel* rx_i = nullptr;
+    iio_channel* rx_q = nullptr;
+    iio_channel* tx_i = nullptr;
+    iio_channel* tx_q = nullptr;
+    AttrCache    attrs;             // PHY settings as last written
+    std::string  serial;            // hw_serial context attribute, else the URI
+};
+
+// Where the time of open_radio() went.
+struct OpenTimes {
+    double context_s = 0;       // iio_create_context_from_uri
+    double discovery_s = 0;     // finding the devices and channels
+    double dds_off_s = 0;       // disabling the DDS test tones
+};
+
+static Radio open_radio(const char* uri, OpenTimes& times) {
+    Radio r;
 
     // ---------- Create IIO context ----------
-    iio_context* ctx = iio_create_context_from_uri(URI);
-    if (!ctx) fatal("Failed to create IIO context. Is the Pluto attached and permissions ok?");
+    uint64_t t0 = mono_ns();
+    r.ctx = iio_create_context_from_uri(uri);
+    if (!r.ctx) fatal("Failed to create IIO context. Is the Pluto attached and permissions ok?");
+    times.context_s = (mono_ns() - t0) * 1e-9;
+    const char* serial = iio_context_get_attr_value(r.ctx, "hw_serial");
+    r.serial = serial && *serial ? serial : uri;
 
     // ---------- Find devices ----------
-    iio_device* phy = iio_context_find_device(ctx, "ad9361-phy");
-    if (!phy) fatal("Device 'ad9361-phy' not found");
+    t0 = mono_ns();
+    r.phy = iio_context_find_device(r.ctx, "ad9361-phy");
+    if (!r.phy) fatal("Device 'ad9361-phy' not found");
+
+    r.rx = iio_context_find_device(r.ctx, "cf-ad9361-lpc");
+    if (!r.rx) fatal("Device 'cf-ad9361-lpc' (RX) not found");
+
+    r.tx = iio_context_find_device(r.ctx, "cf-ad9361-dds-core-lpc");
+    if (!r.tx) fatal("Device 'cf-ad9361-dds-core-lpc' (TX) not found");
 
-    iio_device* rx = iio_context_find_device(ctx, "cf-ad9361-lpc");
-    if (!rx) fatal("Device 'cf-ad9361-lpc' (RX) not found");
+    // ---------- PHY channels ----------
+    r.rx_lo = iio_device_find_channel(r.phy, "altvoltage0", true); // RX LO
+    r.tx_lo = iio_device_find_channel(r.phy, "altvoltage1", true); // TX LO
+    if (!r.rx_lo || !r.tx_lo) fatal("Failed to find LO channels on ad9361-phy");
 
-    iio_device* tx = iio_context_find_device(ctx, "cf-ad9361-dds-core-lpc");
-    if (!tx) fatal("Device 'cf-ad9361-dds-core-lpc' (TX) not found");
+    r.rx_bb = iio_device_find_channel(r.phy, "voltage0", false); // RX baseband ctrl
+    r.tx_bb = iio_device_find_channel(r.phy, "voltage0", true);  // TX baseband ctrl
+    if (!r.rx_bb || !r.tx_bb) fatal("Failed to find baseband channels on ad9361-phy");
 
-    // ---------- Configure LO and baseband via PHY ----------
-    iio_channel* rx_lo = iio_device_find_channel(phy, "altvoltage0", true); // RX LO
-    iio_channel* tx_lo = iio_device_find_channel(phy, "altvoltage1", true); // TX LO
-    if (!rx_lo || !tx_lo) fatal("Failed to find LO channels on ad9361-phy");
+    // ---------- Streaming channels ----------
+    r.rx_i = iio_device_find_channel(r.rx, "voltage0", false); // I
+    r.rx_q = iio_device_find_channel(r.rx, "voltage1", false); // Q
+    if (!r.rx_i || !r.rx_q) fatal("RX I/Q channels not found");
 
-    write_attr_ll_dbg(rx_lo, "frequency", RX_LO_HZ);
-    write_attr_ll_dbg(tx_lo, "frequency", TX_LO_HZ);
+    r.tx_i = iio_device_find_channel(r.tx, "voltage0", true); // I
+    r.tx_q = iio_device_find_channel(r.tx, "voltage1", true); // Q
+    if (!r.tx_i || !r.tx_q) fatal("TX I/Q channels not found");
 
-    iio_channel* rx_bb = iio_device_find_channel(phy, "voltage0", false); // RX baseband ctrl
-    iio_channel* tx_bb = iio_device_find_channel(phy, "voltage0", true);  // TX baseband ctrl
-    if (!rx_bb || !tx_bb) fatal("Failed to find baseband channels on ad9361-phy");
+    iio_channel* tones[4];
+    const char* TONES[] = {"altvoltage0", "altvoltage1", "altvoltage2", "altvoltage3"};
+    for (size_t k = 0; k < 4; ++k) tones[k] = iio_device_find_channel(r.tx, TONES[k], true);
+    times.discovery_s = (mono_ns() - t0) * 1e-9;
+
+    // ---------- Disable TX DDS test tones ----------
+    t0 = mono_ns();
+    for (iio_channel* ch : tones)
+        if (ch) write_attr_str_dbg(ch, "raw", "0");
+    times.dds_off_s = (mono_ns() - t0) * 1e-9;
+    return r;
+}
+
+static void close_radio(Radio& r) {
+    if (r.ctx) iio_context_destroy(r.ctx);
+    r = Radio();
+}
+
+// Sets rate, bandwidth and LOs, writing only what differs from the last
+// configuration. Returns how many requests went to the device.
+static unsigned configure_radio(Radio& r, long long sample_rate, long long rf_bandwidth,
+                                long long rx_lo_hz, long long tx_lo_hz) {
+    AttrCache& a = r.attrs;
+    a.set(r.rx_lo, "frequency", rx_lo_hz);
+    a.set(r.tx_lo, "frequency", tx_lo_hz);
 
     // Optional RX gain control (uncomment ONE of the following):
-    // write_attr_str_dbg(rx_bb, "gain_control_mode", "slow_attack");
-    // write_attr_str_dbg(rx_bb, "gain_control_mode", "manual");
-    // write_attr_str_dbg(rx_bb, "hardwaregain", "0"); // valid when "manual"
+    // a.set(r.rx_bb, "gain_control_mode", "slow_attack");
+    // a.set(r.rx_bb, "gain_control_mode", "manual");
+    // a.set(r.rx_bb, "hardwaregain", "0"); // valid when "manual"
 
     // Optional: lower TX analog power a lot (more negative = less power)
-    // write_attr_str_dbg(tx_bb, "hardwaregain", "-70"); // dB
+    // a.set(r.tx_bb, "hardwaregain", "-70"); // dB
 
     // Shared Pluto rate: set once on RX baseband
-    write_attr_ll_dbg(rx_bb, "sampling_frequency", SAMPLE_RATE);
+    if (a.set(r.rx_bb, "sampling_frequency", sample_rate)) {
+        // The driver clamps rf_bandwidth against the current rate, so the
+        // rate must be in place first, and a new rate re-sends the bandwidth
+        a.forget(r.rx_bb, "rf_bandwidth");
+        a.forget(r.tx_bb, "rf_bandwidth");
+    }
+    unsigned requests = a.commit();
 
     // Keep RX/TX RF bandwidth consistent with sample rate
-    write_attr_ll_dbg(rx_bb, "rf_bandwidth", 5000000);
-    write_attr_ll_dbg(tx_bb, "rf_bandwidth", 5000000);
+    a.set(r.rx_bb, "rf_bandwidth", rf_bandwidth);
+    a.set(r.tx_bb, "rf_bandwidth", rf_bandwidth);
+    return requests + a.commit();
+}
 
-    // ---------- Disable TX DDS test tones ----------
-    for (const char* tone : {"altvoltage0","altvoltage1","altvoltage2","altvoltage3"}) {
-        iio_channel* ch = iio_device_find_channel(tx, tone, true);
-        if (ch) write_attr_str_dbg(ch, "raw", "0");
+// Gain settings as the driver reports them (e.g. "71.000000 dB"); the run
+// leaves gain control at the device defaults, so these are read back.
+struct GainReadback {
+    std::string rx_mode, rx_gain, tx_gain;
+};
+
+static GainReadback read_gains(Radio& r) {
+    return {r.attrs.read(r.rx_bb, "gain_control_mode"), r.attrs.read(r.rx_bb, "hardwaregain"),
+            r.attrs.read(r.tx_bb, "hardwaregain")};
+}
+
+// ---------- Streaming ----------
+struct StreamConfig {
+    size_t  nsamples = 0;           // stop once this many went each way (0 = use seconds)
+    double  seconds  = 0.0;         // stop after this long (0 = use nsamples)
+    size_t  rx_buf_samples = 4096;  // complex samples per RX buffer
+    size_t  tx_buf_samples = 4096;  // complex samples per TX buffer
+    int16_t amp = 100;              // TX symbol amplitude (reduce if RX clips)
+    bool    capture = true;         // keep every sample (for the CSV)
+    size_t  marker_every = 8;       // TX buffers between latency markers (with a meter)
+    int     rt_priority = 0;        // SCHED_FIFO priority of both threads (0 = normal)
+    int     tx_cpu = -1;            // core for the TX thread (-1 = any)
+    int     rx_cpu = -1;            // core for the RX thread (-1 = any)
+    bool    prefault = false;       // touch capture memory and stacks before streaming
+    bool    hugepages = false;      // try to put the sample pools on hugepages
+    bool    check_alloc = false;    // fail the run if the streaming loops allocated
+};
+
+struct StreamStats {
+    size_t   sent = 0, recv = 0;
+    double   seconds = 0.0;
+    bool     xflow_ok = true;       // false if the DMA status register is unreadable
+    uint64_t rx_overflows = 0, tx_underflows = 0;
+    size_t   ref_dropped = 0;       // TX reference symbols the analyzer never saw
+    size_t   rec_dropped = 0;       // RX samples missing from the end of the recording
+    size_t   psd_dropped = 0;       // RX samples the spectrum thread skipped
+    uint64_t heap_allocs = 0;       // operator new calls inside the streaming loops
+    uint64_t first_rx_ns = 0;       // mono_ns() when the first RX block arrived
+    uint64_t tx_fill_ns = 0, rx_copy_ns = 0, analysis_ns = 0, marker_ns = 0;   // per-stage totals
+    uint64_t hist_ns = 0;
+    uint64_t psd_ns = 0;            // spectrum thread
+    uint64_t shm_ns = 0;
+    LatencyHistogram push_lat, refill_lat;   // per-call latency of the blocking calls
+};
+
+struct Capture {
+    BlockPool tx, rx;   // TX reference symbols and RX samples
+};
+
+// Welch spectrum of the RX stream, estimated on its own thread and written
+// as CSV every `interval_s` while streaming and once at the end.
+struct SpectrumTap {
+    WelchPsd    psd;
+    std::string path;
+    double      interval_s = 0;        // 0 = only at the end
+    double      sample_rate = 0, center_hz = 0;
+
+    // Writes a temporary file and renames it, so readers never see half a file.
+    bool write() const {
+        const std::string tmp = path + ".tmp";
+        return psd.write_csv(tmp, sample_rate, center_hz) && std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+};
+
+// ---------- DMA buffers ----------
+// Created on first use and kept until released, so back-to-back runs with
+// the same buffer sizes skip the buffer setup. Retuning the LOs, bandwidth
+// or gains does not need new buffers; a new sample rate gets them anyway
+// (release first), so the DMA restarts cleanly at that rate.
+struct StreamBuffers {
+    iio_buffer* rx = nullptr;
+    iio_buffer* tx = nullptr;
+    size_t      rx_samples = 0, tx_samples = 0;
+    unsigned    created = 0, reused = 0;   // ensure_buffers() outcomes
+    bool        ready = false;             // fresh or drained, not streamed from yet
+};
+
+// Blocks the RX DMA queues up while nobody reads (the libiio default).
+static const unsigned RX_KERNEL_BUFFERS = 4;
+
+static void release_buffers(const Radio& r, StreamBuffers& b) {
+    if (!b.rx && !b.tx) return;
+    if (b.tx) iio_buffer_destroy(b.tx);
+    if (b.rx) iio_buffer_destroy(b.rx);
+    iio_channel_disable(r.tx_i);
+    iio_channel_disable(r.tx_q);
+    iio_channel_disable(r.rx_i);
+    iio_channel_disable(r.rx_q);
+    b.rx = b.tx = nullptr;
+    b.ready = false;
+}
+
+static void ensure_buffers(const Radio& r, StreamBuffers& b, size_t rx_samples, size_t tx_samples) {
+    if (b.rx && b.tx && b.rx_samples == rx_samples && b.tx_samples == tx_samples) {
+        if (b.ready) return;
+        // RX kept capturing since the last run; drop the stale blocks so the
+        // stream starts with samples taken after the retune
+        for (unsigned k = 0; k < RX_KERNEL_BUFFERS; ++k) iio_buffer_refill(b.rx);
+        b.reused++;
+        b.ready = true;
+        return;
+    }
+    release_buffers(r, b);
+    iio_channel_enable(r.rx_i);
+    iio_channel_enable(r.rx_q);
+    b.rx = iio_device_create_buffer(r.rx, rx_samples, false);
+    if (!b.rx) fatal("Could not create RX buffer");
+
+    iio_channel_enable(r.tx_i);
+    iio_channel_enable(r.tx_q);
+    b.tx = iio_device_create_buffer(r.tx, tx_samples, false);
+    if (!b.tx) fatal("Could not create TX buffer");
+    b.rx_samples = rx_samples;
+    b.tx_samples = tx_samples;
+    b.created++;
+    b.ready = true;
+}
+
+// Streams random QPSK out and reads the loopback back in, TX and RX each on
+// their own thread. Sample storage comes from the preallocated pools in
+// `cap`; with cfg.capture unset they only hold the current block. `link`,
+// `loop` (latency markers in the TX stream), `metrics`, `hist` (RX
+// constellation density), `spectrum`, `live` (shared-memory ring for other
+// processes) and `rec` (recording of the RX samples) are optional; link,
+// loop, hist and live are only touched from the RX thread apart from the
+// lock-free TX hand-offs. The spectrum and the recording each get the RX
+// samples on a thread of their own.
+static void run_stream(const Radio& r, StreamBuffers& bufs, const StreamConfig& cfg, Capture& cap,
+                       LinkAnalyzer* link, LoopLatencyMeter* loop, Metrics* metrics,
+                       IqHistogram* hist, SpectrumTap* spectrum, ShmRingWriter* live,
+                       SampleSink* rec, StreamStats& st) {
+    // ---------- Prepare RX/TX buffers ----------
+    ensure_buffers(r, bufs, cfg.rx_buf_samples, cfg.tx_buf_samples);
+    iio_buffer* rxbuf = bufs.rx;
+    iio_buffer* txbuf = bufs.tx;
+    bufs.ready = false;
+
+    // ---------- Sample pools: every block the loops touch, mapped up front ----------
+    auto blocks = [&](size_t buf) { return cfg.capture ? (cfg.nsamples + buf - 1) / buf : 1; };
+    std::string pool_err = cap.tx.init(cfg.tx_buf_samples, blocks(cfg.tx_buf_samples),
+                                       !cfg.capture, cfg.hugepages);
+    if (pool_err.empty())
+        pool_err = cap.rx.init(cfg.rx_buf_samples, blocks(cfg.rx_buf_samples),
+                               !cfg.capture, cfg.hugepages);
+    if (!pool_err.empty()) fatal(pool_err);
+    if (cfg.prefault) {
+        cap.tx.prefault();
+        cap.rx.prefault();
     }
 
-    // ---------- Prepare RX channels & buffer ----------
-    iio_channel* rx_i = iio_device_find_channel(rx, "voltage0", false); // I
-    iio_channel* rx_q = iio_device_find_channel(rx, "voltage1", false); // Q
-    if (!rx_i || !rx_q) fatal("RX I/Q channels not found");
-    iio_channel_enable(rx_i);
-    iio_channel_enable(rx_q);
+    // TX reference symbols travel to the analyzer on the RX thread
+    const size_t REF_FIFO_SAMPLES = 1u << 20;
+    SampleFifo tx_ref(link ? REF_FIFO_SAMPLES : 1);
 
-    const size_t RX_BUF_SAMPLES = 4096; // complex samples per RX buffer
-    iio_buffer* rxbuf = iio_device_create_buffer(rx, RX_BUF_SAMPLES, false);
-    if (!rxbuf) fatal("Could not create RX buffer");
+    // RX samples travel to the recorder thread
+    const size_t REC_FIFO_SAMPLES = 1u << 22;
+    SampleFifo rec_fifo(rec ? REC_FIFO_SAMPLES : 1);
+    std::atomic<bool> rx_done{false};
 
-    // ---------- Prepare TX channels & buffer ----------
-    iio_channel* tx_i_ch = iio_device_find_channel(tx, "voltage0", true); // I
-    iio_channel* tx_q_ch = iio_device_find_channel(tx, "voltage1", true); // Q
-    if (!tx_i_ch || !tx_q_ch) fatal("TX I/Q channels not found");
-    iio_channel_enable(tx_i_ch);
-    iio_channel_enable(tx_q_ch);
+    // RX samples travel to the spectrum thread; what does not fit is skipped
+    const size_t PSD_FIFO_SAMPLES = 1u << 20;
+    SampleFifo psd_fifo(spectrum ? PSD_FIFO_SAMPLES : 1);
+    std::atomic<bool> psd_gap{false};
 
-    const size_t TX_BUF_SAMPLES = 4096; // complex samples per TX buffer
-    iio_buffer* txbuf = iio_device_create_buffer(tx, TX_BUF_SAMPLES, false);
-    if (!txbuf) fatal("Could not create TX buffer");
+    const size_t   limit    = cfg.nsamples ? cfg.nsamples : SIZE_MAX;
+    const uint64_t t_start  = mono_ns();
+    const uint64_t deadline = cfg.seconds > 0 ? t_start + uint64_t(cfg.seconds * 1e9) : UINT64_MAX;
+    const uint64_t PUBLISH_NS = 100000000; // 100 ms between status polls
 
-    // ---------- Generate and stream random BPSK on Q (I=0, Q=±AMP) ----------
-    std::mt19937 rng(42);
-    std::bernoulli_distribution bitdist(0.5);
+    // Clear stale over/underflow flags from before this run
+    st.xflow_ok = check_xflow(r.rx, RX_OVERFLOW_BIT) >= 0 && check_xflow(r.tx, TX_UNDERFLOW_BIT) >= 0;
+    auto poll_xflow = [&] {
+        if (!st.xflow_ok) return;
+        const int o = check_xflow(r.rx, RX_OVERFLOW_BIT);
+        const int u = check_xflow(r.tx, TX_UNDERFLOW_BIT);
+        if (o < 0 || u < 0) st.xflow_ok = false;
+        st.rx_overflows  += (o > 0);
+        st.tx_underflows += (u > 0);
+    };
 
-    std::vector<int16_t> all_tx_i; all_tx_i.reserve(NSAMPLES);
-    std::vector<int16_t> all_tx_q; all_tx_q.reserve(NSAMPLES);
-    std::vector<int16_t> all_rx_i; all_rx_i.reserve(NSAMPLES);
-    std::vector<int16_t> all_rx_q; all_rx_q.reserve(NSAMPLES);
+    // ---------- TX thread: fill buffer with random QPSK (I,Q = ±AMP) and push ----------
+    auto tx_main = [&] {
+        const std::string err = set_thread_realtime(cfg.rt_priority, cfg.tx_cpu);
+        if (!err.empty()) fatal("TX thread: " + err);
+        if (cfg.prefault) prefault_stack();
+        tracer().register_thread("tx");
 
-    size_t total_sent = 0, total_recv = 0;
+        std::mt19937 rng(TX_SEED);
+        std::bernoulli_distribution bitdist(0.5);
+        size_t   tx_blocks = 0;
+        uint16_t marker_id = 0;
+        int16_t  mk_i[MARKER_LEN], mk_q[MARKER_LEN];
+        bool     ref_ok = true;
+        uint64_t t_publish = t_start;
 
-    while (total_sent < NSAMPLES || total_recv < NSAMPLES) {
-        // ---- TX: fill buffer with random BPSK symbols on Q ----
-        if (total_sent < NSAMPLES) {
-            void* tx_start = iio_buffer_first(txbuf, tx_i_ch);
+        AllocCounting counting(true);
+        while (st.sent < limit && mono_ns() < deadline) {
+            void* tx_start = iio_buffer_first(txbuf, r.tx_i);
             void* tx_end   = iio_buffer_end(txbuf);
             ptrdiff_t inc  = iio_buffer_step(txbuf);
 
-            uint8_t* p = static_cast<uint8_t*>(tx_start);
-            for (; p < tx_end && total_sent < NSAMPLES; p += inc) {
-                int16_t* s = reinterpret_cast<int16_t*>(p);
-                const int bit_I = bitdist(rng) ? 1 : 0;
-                const int bit_Q = bitdist(rng) ? 1 : 0;
-                const int16_t i_val = bit_I ? AMP : -AMP;
-                const int16_t q_val = bit_Q ? AMP : -AMP;
-                s[0] = i_val; // I
-                s[1] = q_val; // Q
-                all_tx_i.push_back(i_val);
-                all_tx_q.push_back(q_val);
-                total_sent++;
+            const SampleBlock blk = cap.tx.acquire();
+            if (blk.capacity == 0) fatal("TX sample pool exhausted");
+            size_t n = 0;
+            {
+                TraceScope span("tx_fill");
+                StageTimer timer(st.tx_fill_ns);
+                n = fill_tx_block(static_cast<uint8_t*>(tx_start), tx_end, inc,
+                                  std::min(limit - st.sent, blk.capacity), rng, bitdist, cfg.amp,
+                                  blk.i, blk.q);
+            }
+            // Overwrite the head of every marker_every-th buffer with a marker
+            if (loop && tx_blocks++ % cfg.marker_every == 0 && n >= MARKER_LEN) {
+                marker_symbols(marker_id, cfg.amp, mk_i, mk_q);
+                uint8_t* p = static_cast<uint8_t*>(tx_start);
+                for (size_t k = 0; k < MARKER_LEN; ++k, p += inc) {
+                    int16_t* s = reinterpret_cast<int16_t*>(p);
+                    s[0] = blk.i[k] = mk_i[k];
+                    s[1] = blk.q[k] = mk_q[k];
+                }
+                loop->on_tx_marker(marker_id++, st.sent, mono_ns());
+            }
+            // After a drop the reference stops: later RX is left uncompared
+            // rather than compared against the wrong symbols.
+            if (link && ref_ok) {
+                const size_t took = tx_ref.push(blk.i, blk.q, n);
+                if (took < n) { ref_ok = false; st.ref_dropped += n - took; }
+            } else if (link) {
+                st.ref_dropped += n;
+            }
+            cap.tx.commit(n);
+            st.sent += n;
+
+            ssize_t ret;
+            {
+                TraceScope span("push");
+                AllocCounting not_ours(false);   // libiio internals are not counted
+                const uint64_t t0 = mono_ns();
+                ret = iio_buffer_push(txbuf);
+                st.push_lat.record(mono_ns() - t0);
+            }
+            if (ret < 0) fatal("iio_buffer_push(tx) failed");
+
+            const uint64_t now = mono_ns();
+            if (metrics && now - t_publish >= PUBLISH_NS) {
+                t_publish = now;
+                metrics->tx_samples.store(st.sent, std::memory_order_relaxed);
+                Metrics::publish_latency(st.push_lat, metrics->push_latency);
             }
-            if (iio_buffer_push(txbuf) < 0) fatal("iio_buffer_push(tx) failed");
         }
+    };
 
-        // ---- RX: pull a buffer and copy samples ----
-        if (total_recv < NSAMPLES) {
-            if (iio_buffer_refill(rxbuf) < 0) fatal("iio_buffer_refill(rx) failed");
+    // ---------- RX thread: refill, copy and analyse ----------
+    auto rx_main = [&] {
+        const std::string err = set_thread_realtime(cfg.rt_priority, cfg.rx_cpu);
+        if (!err.empty()) fatal("RX thread: " + err);
+        if (cfg.prefault) prefault_stack();
+        tracer().register_thread("rx");
 
-            void* rx_start = iio_buffer_first(rxbuf, rx_i);
+        uint64_t t_publish = t_start;
+        bool     rec_ok = true;
+        AllocCounting counting(true);
+        while (st.recv < limit && mono_ns() < deadline) {
+            ssize_t ret;
+            uint64_t t_visible;
+            {
+                TraceScope span("refill");
+                AllocCounting not_ours(false);
+                const uint64_t t0 = mono_ns();
+                ret = iio_buffer_refill(rxbuf);
+                t_visible = mono_ns();
+                st.refill_lat.record(t_visible - t0);
+            }
+            if (ret < 0) fatal("iio_buffer_refill(rx) failed");
+            if (!st.first_rx_ns) st.first_rx_ns = t_visible;
+
+            void* rx_start = iio_buffer_first(rxbuf, r.rx_i);
             void* rx_end   = iio_buffer_end(rxbuf);
             ptrdiff_t inc  = iio_buffer_step(rxbuf);
 
-            uint8_t* p = static_cast<uint8_t*>(rx_start);
-            for (; p < rx_end && total_recv < NSAMPLES; p += inc) {
-                const int16_t* s = reinterpret_cast<const int16_t*>(p);
-                all_rx_i.push_back(s[0]);
-                all_rx_q.push_back(s[1]);
-                total_recv++;
+            const SampleBlock blk = cap.rx.acquire();
+            if (blk.capacity == 0) fatal("RX sample pool exhausted");
+            size_t n = 0;
+            {
+                TraceScope span("rx_copy");
+                StageTimer timer(st.rx_copy_ns);
+                n = copy_rx_block(static_cast<const uint8_t*>(rx_start), rx_end, inc,
+                                  std::min(limit - st.recv, blk.capacity), blk.i, blk.q);
+            }
+            cap.rx.commit(n);
+            st.recv += n;
+            // Like the TX reference: after a drop the recording stops, so the
+            // file is always a gap-free prefix of the stream.
+            if (rec && rec_ok) {
+                const size_t took = rec_fifo.push(blk.i, blk.q, n);
+                if (took < n) { rec_ok = false; st.rec_dropped += n - took; }
+            } else if (rec) {
+                st.rec_dropped += n;
+            }
+            if (link) {
+                TraceScope span("link_analysis");
+                StageTimer timer(st.analysis_ns);
+                tx_ref.drain([&](const int16_t* i, const int16_t* q, size_t k) {
+                    link->push_tx(i, q, k);
+                });
+                link->push_rx(blk.i, blk.q, n);
+            }
+            if (loop) {
+                TraceScope span("marker_detect");
+                StageTimer timer(st.marker_ns);
+                loop->push_rx(blk.i, blk.q, n, t_visible);
+            }
+            if (hist) {
+                TraceScope span("constellation");
+                StageTimer timer(st.hist_ns);
+                hist->add(blk.i, blk.q, n);
+            }
+            if (live) {
+                TraceScope span("shm_publish");
+                StageTimer timer(st.shm_ns);
+                live->publish(blk.i, blk.q, n);
+            }
+            if (spectrum) {
+                const size_t took = psd_fifo.push(blk.i, blk.q, n);
+                if (took < n) {
+                    st.psd_dropped += n - took;
+                    psd_gap.store(true, std::memory_order_relaxed);
+                }
+            }
+
+            // ---- Periodic: DMA over/underflow flags and metrics snapshot ----
+            const uint64_t now = mono_ns();
+            if (now - t_publish >= PUBLISH_NS) {
+                TraceScope span("status_poll");
+                t_publish = now;
+                {
+                    AllocCounting not_ours(false);   // register access goes through libiio
+                    poll_xflow();
+                }
+                if (metrics) {
+                    metrics->rx_samples.store(st.recv, std::memory_order_relaxed);
+                    metrics->rx_overflows.store(st.rx_overflows, std::memory_order_relaxed);
+                    metrics->tx_underflows.store(st.tx_underflows, std::memory_order_relaxed);
+                    metrics->throughput_sps.store(st.recv / ((now - t_start) * 1e-9),
+                                                  std::memory_order_relaxed);
+                    if (link) {
+                        metrics->bits.store(link->bits(), std::memory_order_relaxed);
+                        metrics->bit_errors.store(link->bit_errors(), std::memory_order_relaxed);
+                        metrics->clipped_samples.store(link->clipped(), std::memory_order_relaxed);
+                        metrics->ber.store(link->ber(), std::memory_order_relaxed);
+                        metrics->snr_db.store(link->snr_db(), std::memory_order_relaxed);
+                    }
+                    Metrics::publish_latency(st.refill_lat, metrics->refill_latency);
+                }
+            }
+        }
+    };
+
+    // ---------- Recorder thread: RX samples to the sink (encoding, disk writes) ----------
+    auto writer_main = [&] {
+        tracer().register_thread("recorder");
+        uint64_t recorded = 0;
+        for (;;) {
+            const bool last = rx_done.load(std::memory_order_acquire);
+            // Everything drained arrived before `now`; the next sample is due
+            // within a buffer, which bounds the error of the timestamp.
+            const int64_t now = wall_ns();
+            rec_fifo.drain([&](const int16_t* i, const int16_t* q, size_t k) {
+                TraceScope span("record");
+                rec->write(i, q, k);
+                recorded += k;
+            });
+            rec->mark_time(recorded, now);
+            if (last) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    };
+
+    // ---------- Spectrum thread: Welch PSD of the RX samples, best effort ----------
+    auto spectrum_main = [&] {
+        tracer().register_thread("spectrum");
+        const uint64_t every = spectrum->interval_s > 0 ? uint64_t(spectrum->interval_s * 1e9) : 0;
+        uint64_t t_write = mono_ns();
+        for (;;) {
+            const bool last = rx_done.load(std::memory_order_acquire);
+            psd_fifo.drain([&](const int16_t* i, const int16_t* q, size_t k) {
+                TraceScope span("psd");
+                StageTimer timer(st.psd_ns);
+                spectrum->psd.push(i, q, k);
+            });
+            // Samples were skipped: do not let a segment straddle the gap
+            if (psd_gap.exchange(false, std::memory_order_relaxed)) spectrum->psd.restart_segment();
+            if (last) break;
+            if (every && mono_ns() - t_write >= every) {
+                TraceScope span("psd_write");
+                t_write = mono_ns();
+                spectrum->write();
             }
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
         }
+    };
+
+    if (live) live->set_start_time(wall_ns());
+    const uint64_t allocs_before = g_counted_allocs.load();
+    std::thread tx_thread(tx_main);
+    std::thread rx_thread(rx_main);
+    std::thread writer_thread, spectrum_thread;
+    if (rec) writer_thread = std::thread(writer_main);
+    if (spectrum) spectrum_thread = std::thread(spectrum_main);
+    tx_thread.join();
+    rx_thread.join();
+    st.heap_allocs = g_counted_allocs.load() - allocs_before;
+    rx_done.store(true, std::memory_order_release);
+    if (writer_thread.joinable()) writer_thread.join();
+    if (spectrum_thread.joinable()) spectrum_thread.join();
+
+    poll_xflow();
+    st.seconds = (mono_ns() - t_start) * 1e-9;
+    if (link) {
+        tx_ref.drain([&](const int16_t* i, const int16_t* q, size_t k) { link->push_tx(i, q, k); });
+        link->finish();
     }
 
-    // ---------- Clean up streaming ----------
-    iio_buffer_destroy(txbuf);
-    iio_buffer_destroy(rxbuf);
-    iio_channel_disable(tx_i_ch);
-    iio_channel_disable(tx_q_ch);
-    iio_channel_disable(rx_i);
-    iio_channel_disable(rx_q);
+    if (cfg.check_alloc && st.heap_allocs)
+        fatal(std::to_string(st.heap_allocs) + " heap allocations while streaming");
+}
+
+// ---------- Maximum sustainable sample rate ----------
+// Rates the AD9361 supports without FIR decimation, lowest first.
+static const long long STRESS_RATES[] = {
+    3840000, 5000000, 7680000, 10000000, 15360000, 20000000,
+    25000000, 30720000, 40000000, 50000000, 61440000,
+};
 
-    // ---------- Write CSV (raw only): n,tx_i,tx_q,rx_i,rx_q ----------
-    std::ofstream ofs(CSV_PATH);
-    if (!ofs) fatal("Failed to open CSV for writing");
-    ofs << "n,tx_i,tx_q,rx_i,rx_q\n";
-    for (size_t n = 0; n < NSAMPLES; ++n) {
-        const int16_t txi = (n < all_tx_i.size()) ? all_tx_i[n] : 0;
-        const int16_t txq = (n < all_tx_q.size()) ? all_tx_q[n] : 0;
-        const int16_t rxi = (n < all_rx_i.size()) ? all_rx_i[n] : 0;
-        const int16_t rxq = (n < all_rx_q.size()) ? all_rx_q[n] : 0;
-        ofs << n << "," << txi << "," << txq << "," << rxi << "," << rxq << "\n";
+// rf_bandwidth tracks the sample rate within the AD9361 limits.
+static long long bandwidth_for_rate(long long rate) {
+    return std::min(std::max(rate, 200000LL), 56000000LL);
+}
+
+// Consumers a normal run with the same options attaches to the stream, so
+// the processing pass of the stress test loads the RX path the same way.
+struct StressLoad {
+    bool        latency = false;        // markers in the TX stream
+    bool        constellation = false;
+    size_t      psd_nfft = 0;           // 0 = no spectrum
+    std::string shm_name;               // "" = no live ring
+    size_t      shm_samples = 0;
+    std::string record_path;            // "" = no recording; removed after each step
+    bool        pack = false;           // record bcap instead of raw ci16
+
+    // e.g. "link analysis, spectrum, recording"
+    std::string describe() const {
+        std::string d = "link analysis";
+        if (latency) d += ", latency markers";
+        if (constellation) d += ", constellation";
+        if (psd_nfft) d += ", spectrum";
+        if (!shm_name.empty()) d += ", live ring";
+        if (!record_path.empty()) d += ", recording";
+        return d;
     }
-    ofs.close();
+};
+
+// Steps the rate up, streaming `seconds` at each step, and returns the
+// highest rate with no DMA over/underflow and no shortfall in RX samples.
+// With `load`, every step runs the link analysis and the consumers it lists.
+static long long stress_sweep(Radio& r, const StreamConfig& base, long long rx_lo,
+                              long long tx_lo, double seconds, const StressLoad* load) {
+    long long best = 0;
+    for (long long rate : STRESS_RATES) {
+        configure_radio(r, rate, bandwidth_for_rate(rate), rx_lo, tx_lo);
+
+        StreamConfig cfg = base;
+        cfg.nsamples = 0;
+        cfg.seconds = seconds;
+        cfg.capture = false;
+        Capture scratch;
+        StreamStats st;
+        LinkAnalyzer link;
+        LoopLatencyMeter loop(cfg.amp, static_cast<double>(rate));
+        Metrics metrics;
+        IqHistogram hist;
+        SpectrumTap spectrum{WelchPsd(load && load->psd_nfft ? load->psd_nfft : 1024), "", 0,
+                             static_cast<double>(rate), static_cast<double>(rx_lo)};
+        ShmRingWriter live;
+        SigmfDataWriter rec;
+        CaptureWriter packed;
+        SampleSink* sink = nullptr;
+        if (load && !load->shm_name.empty()) {
+            const std::string err = live.create(load->shm_name, load->shm_samples, static_cast<double>(rate),
+                                                static_cast<double>(rx_lo));
+            if (!err.empty()) fatal("Could not create live ring: " + err);
+        }
+        if (load && !load->record_path.empty()) {
+            const std::string err = load->pack ? packed.open(load->record_path, rate) : rec.open(load->record_path);
+            if (!err.empty()) fatal("Could not open recording " + err);
+            sink = load->pack ? static_cast<SampleSink*>(&packed) : &rec;
+        }
+        StreamBuffers bufs;
+        if (load)
+            run_stream(r, bufs, cfg, scratch, &link, load->latency ? &loop : nullptr, &metrics,
+                       load->constellation ? &hist : nullptr, load->psd_nfft ? &spectrum : nullptr,
+                       live.is_open() ? &live : nullptr, sink, st);
+        else
+            run_stream(r, bufs, cfg, scratch, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, st);
+        release_buffers(r, bufs);
+        live.close();
+        if (sink) {
+            const std::string err = load->pack ? packed.close() : rec.close();
+            if (!err.empty()) fatal("Failed to write recording: " + err);
+            std::remove(load->record_path.c_str());
+        }
+        if (!st.xflow_ok) fatal("Stress test needs access to the AXI DMAC status registers");
+
+        const double achieved = st.recv / st.seconds;
+        const bool ok = st.rx_overflows == 0 && st.tx_underflows == 0 && achieved >= 0.95 * rate;
+        char line[160];
+        std::snprintf(line, sizeof(line),
+                      "  %7.3f MSPS  rx %9.3f MSPS  overflows %3llu  underflows %3llu  %s",
+                      rate * 1e-6, achieved * 1e-6,
+                      static_cast<unsigned long long>(st.rx_overflows),
+                      static_cast<unsigned long long>(st.tx_underflows), ok ? "ok" : "FAIL");
+        std::cout << line << std::endl;
+        if (!ok) break;
+        best = rate;
+    }
+    return best;
+}
+
+// ---------- Marker-based loop latency report ----------
+static void print_loop_latency(const LoopLatencyMeter& loop) {
+    const LatencyHistogram& lag = loop.lag_samples();
+    const double us_per_sample = 1e6 / loop.sample_rate();
+    std::cout << "Loop latency: " << loop.matched() << " markers matched ("
+              << loop.detected() << " detected)\n";
+    if (lag.count() == 0) return;
+    char line[192];
+    std::snprintf(line, sizeof(line),
+                  "  stream lag        p50=%llu p99=%llu max=%llu samples"
+                  " (p50 %.1f us at %.3f MSPS)",
+                  static_cast<unsigned long long>(lag.percentile(0.50)),
+                  static_cast<unsigned long long>(lag.percentile(0.99)),
+                  static_cast<unsigned long long>(lag.max()),
+                  lag.percentile(0.50) * us_per_sample, loop.sample_rate() * 1e-6);
+    std::cout << line << "\n";
+    loop.latency_ns().print_summary(std::cout, "  txbuf->rxbuf");
+    std::cout << "  BER alignment: --lag " << lag.percentile(0.50) << std::endl;
+}
+
+// ---------- Command line ----------
+struct Options {
+    std::string uri          = "usb:1.6.5";      // e.g., "usb:1.5.5" or "ip:192.168.2.1"
+    long long   sample_rate  = 3840000;          // 3.84 MSPS (supported by DMA cores)
+    long long   rf_bandwidth = 5000000;          // 5 MHz
+    long long   rx_lo_hz     = 2400000000LL;     // 2.4 GHz
+    long long   tx_lo_hz     = 2400000000LL;     // 2.4 GHz
+    size_t      nsamples     = 16384;            // complex samples to send/receive
+    size_t      buf_samples  = 4096;             // complex samples per RX/TX buffer
+    int         amp          = 100;              // TX symbol amplitude (reduce if RX clips)
+    std::string csv_path     = "../samples.csv";
+    int         metrics_port = 0;                // 0 = no metrics endpoint
+    bool        stress = false;                  // run the sample-rate stress test instead
+    double      stress_seconds = 2.0;            // streaming time per rate step
+    std::string trace_path;                      // Chrome trace JSON written on exit ("" = off)
+    bool        latency = false;                 // embed markers and measure TX->RX latency
+    long long   lag_hint = -1;                   // known TX->RX lag in samples (-1 = search)
+    int         rt_priority = 0;                 // SCHED_FIFO priority for TX/RX threads
+    int         tx_cpu = -1, rx_cpu = -1;        // cores to pin the TX/RX threads to
+    bool        mlock = false;                   // mlockall + prefault before streaming
+    bool        hugepages = false;               // sample pools on hugepages if available
+    bool        check_alloc = false;             // fail if streaming touched the heap
+    std::string report_path;                     // JSON run report ("" = off)
+    std::string sigmf_base;                      // SigMF recording instead of the CSV ("" = off)
+    std::string feather_path;                    // Arrow IPC file instead of the CSV ("" = off)
+    std::string constellation_path;              // RX density histogram, .png or .npy ("" = off)
+    std::string psd_path;                        // Welch PSD of the RX samples, CSV ("" = off)
+    double      psd_interval = 0;                // seconds between PSD rewrites (0 = at the end)
+    size_t      psd_nfft = 1024;                 // FFT size of the PSD segments
+    std::string shm_name;                        // live RX ring in POSIX shared memory ("" = off)
+    std::string campaign_path;                   // measurement points to run back to back ("" = off)
+    size_t      shm_samples = 1u << 22;          // capacity of the live ring
+    std::string serve_path;                      // run as a daemon on this control socket ("" = off)
+    std::string calibration_path;                // per-device calibration cache ("" = off)
+    bool        sim = false;                     // daemon: simulated loopback instead of the Pluto
+    bool        pack = false;                    // SigMF data as a packed/compressed capture
+};
+
+static void usage() {
+    std::cerr << "usage: test [uri] [--samples N] [--metrics-port PORT] [--trace FILE]\n"
+                 "                  [--latency] [--lag SAMPLES]\n"
+                 "                  [--csv PATH | --feather PATH | --sigmf BASE [--pack]]\n"
+                 "                  [--report FILE] [--constellation FILE.png|FILE.npy]\n"
+                 "                  [--psd FILE.csv [--psd-interval S] [--psd-nfft N]]\n"
+                 "                  [--shm NAME [--shm-samples N]]\n"
+                 "       test [uri] --stress [--stress-seconds S] [--trace FILE] [--report FILE]\n"
+                 "       test [uri] --campaign FILE [--trace FILE] [--report FILE]\n"
+                 "       test [uri] --serve SOCKET [--sim] [--trace FILE]\n"
+                 "radio:     [--rate SPS] [--bw HZ] [--rx-lo HZ] [--tx-lo HZ] [--amp A] [--buf N]\n"
+                 "           [--calibration FILE]\n"
+                 "real-time: [--rt-prio 1..99] [--tx-cpu N] [--rx-cpu N] [--mlock] [--hugepages]\n"
+                 "           [--check-alloc]\n";
+    std::exit(1);
+}
+
+static Options parse_options(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        auto next = [&]() -> const char* { if (i + 1 >= argc) usage(); return argv[++i]; };
+        if      (a == "--samples")        o.nsamples = std::strtoull(next(), nullptr, 0);
+        else if (a == "--rate")           o.sample_rate = std::atoll(next());
+        else if (a == "--bw")             o.rf_bandwidth = std::atoll(next());
+        else if (a == "--rx-lo")          o.rx_lo_hz = std::atoll(next());
+        else if (a == "--tx-lo")          o.tx_lo_hz = std::atoll(next());
+        else if (a == "--amp")            o.amp = std::atoi(next());
+        else if (a == "--buf")            o.buf_samples = std::strtoull(next(), nullptr, 0);
+        else if (a == "--csv")            o.csv_path = next();
+        else if (a == "--sigmf")          o.sigmf_base = next();
+        else if (a == "--feather")        o.feather_path = next();
+        else if (a == "--constellation")  o.constellation_path = next();
+        else if (a == "--psd")            o.psd_path = next();
+        else if (a == "--psd-interval")   o.psd_interval = std::atof(next());
+        else if (a == "--psd-nfft")       o.psd_nfft = std::strtoull(next(), nullptr, 0);
+        else if (a == "--shm")            o.shm_name = next();
+        else if (a == "--shm-samples")    o.shm_samples = std::strtoull(next(), nullptr, 0);
+        else if (a == "--pack")           o.pack = true;
+        else if (a == "--metrics-port")   o.metrics_port = std::atoi(next());
+        else if (a == "--stress")         o.stress = true;
+        else if (a == "--campaign")       o.campaign_path = next();
+        else if (a == "--serve")          o.serve_path = next();
+        else if (a == "--sim")            o.sim = true;
+        else if (a == "--calibration")    o.calibration_path = next();
+        else if (a == "--stress-seconds") o.stress_seconds = std::atof(next());
+        else if (a == "--trace")          o.trace_path = next();
+        else if (a == "--report")         o.report_path = next();
+        else if (a == "--latency")        o.latency = true;
+        else if (a == "--lag")            o.lag_hint = std::atoll(next());
+        else if (a == "--rt-prio")        o.rt_priority = std::atoi(next());
+        else if (a == "--tx-cpu")         o.tx_cpu = std::atoi(next());
+        else if (a == "--rx-cpu")         o.rx_cpu = std::atoi(next());
+        else if (a == "--mlock")          o.mlock = true;
+        else if (a == "--hugepages")      o.hugepages = true;
+        else if (a == "--check-alloc")    o.check_alloc = true;
+        else if (a[0] != '-')             o.uri = a;
+        else usage();
+    }
+    if (o.nsamples == 0 || o.buf_samples == 0 || o.stress_seconds <= 0) usage();
+    if (o.amp <= 0 || o.amp > ADC_MAX || o.rt_priority < 0 || o.rt_priority > 99) usage();
+    if (o.pack && o.sigmf_base.empty()) usage();
+    if (o.stress && !o.campaign_path.empty()) usage();
+    if (!o.serve_path.empty() && (o.stress || !o.campaign_path.empty())) usage();
+    if (o.sim && o.serve_path.empty()) usage();
+    if (!o.feather_path.empty() && !o.sigmf_base.empty()) usage();
+    if (o.psd_nfft < 16 || (o.psd_nfft & (o.psd_nfft - 1)) || o.psd_interval < 0) usage();
+    if (o.shm_samples == 0 || o.shm_name.find('/', 1) != std::string::npos) usage();
+    return o;
+}
+
+// Campaign points and daemon settings start from these.
+static CampaignPoint point_defaults(const Options& opt) {
+    CampaignPoint d;
+    d.sample_rate  = opt.sample_rate;
+    d.rf_bandwidth = opt.rf_bandwidth;
+    d.rx_lo_hz     = opt.rx_lo_hz;
+    d.tx_lo_hz     = opt.tx_lo_hz;
+    d.amp          = opt.amp;
+    d.nsamples     = opt.nsamples;
+    d.buf_samples  = opt.buf_samples;
+    d.lag_hint     = opt.lag_hint;
+    return d;
+}
+
+// ---------- Run report (JSON) ----------
+struct RunTimings {
+    std::string started;                 // UTC, ISO 8601
+    double open_s = 0, configure_s = 0, stream_s = 0, output_s = 0, total_s = 0;
+    OpenTimes open;                      // open_s broken down
+    double buffers_s = 0;                // creating the DMA buffers
+    double first_sample_s = 0;           // process start to the first RX block
+};
+
+static std::string utc_now() {
+    char buf[32];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    return buf;
+}
+
+static double gain_db(const std::string& s) { return s.empty() ? NAN : std::atof(s.c_str()); }
+
+static void write_config(JsonWriter& j, const Options& opt, const GainReadback& g) {
+    j.begin_object("config");
+    j.field("uri", opt.uri);
+    j.field("sample_rate", opt.sample_rate);
+    j.field("rf_bandwidth", opt.rf_bandwidth);
+    j.field("rx_lo_hz", opt.rx_lo_hz);
+    j.field("tx_lo_hz", opt.tx_lo_hz);
+    j.field("rx_gain_control_mode", g.rx_mode);
+    j.field("rx_gain_db", gain_db(g.rx_gain));
+    j.field("tx_gain_db", gain_db(g.tx_gain));
+    j.field("nsamples", opt.nsamples);
+    j.field("rx_buf_samples", opt.buf_samples);
+    j.field("tx_buf_samples", opt.buf_samples);
+    j.field("amp", opt.amp);
+    const bool csv = opt.sigmf_base.empty() && opt.feather_path.empty();
+    if (csv) j.field("csv_path", opt.csv_path); else j.null("csv_path");
+    if (opt.sigmf_base.empty()) j.null("sigmf_base"); else j.field("sigmf_base", opt.sigmf_base);
+    if (opt.feather_path.empty()) j.null("feather_path"); else j.field("feather_path", opt.feather_path);
+    if (opt.constellation_path.empty()) j.null("constellation_path");
+    else j.field("constellation_path", opt.constellation_path);
+    if (opt.psd_path.empty()) j.null("psd_path"); else j.field("psd_path", opt.psd_path);
+    if (opt.shm_name.empty()) j.null("shm_name"); else j.field("shm_name", opt.shm_name);
+    j.field("psd_nfft", opt.psd_nfft);
+    j.field("packed_capture", opt.pack);
+    j.field("latency_markers", opt.latency);
+    if (opt.lag_hint >= 0) j.field("lag_hint", opt.lag_hint); else j.null("lag_hint");
+    j.field("rt_priority", opt.rt_priority);
+    j.field("tx_cpu", opt.tx_cpu);
+    j.field("rx_cpu", opt.rx_cpu);
+    j.field("mlock", opt.mlock);
+    j.field("hugepages", opt.hugepages);
+    j.end_object();
+}
+
+// Rate with a 95% Wilson interval, as {"value", "ci95_low", "ci95_high"}.
+static void write_rate(JsonWriter& j, const char* key, uint64_t k, uint64_t n) {
+    double lo, hi;
+    wilson_interval(k, n, 1.96, lo, hi);
+    j.begin_object(key);
+    j.field("value", n ? double(k) / double(n) : NAN);
+    j.field("ci95_low", lo);
+    j.field("ci95_high", hi);
+    j.end_object();
+}
+
+static bool write_run_report(const std::string& path, const Options& opt, const GainReadback& g,
+                             const RunTimings& t, const StreamStats& st, const LinkAnalyzer& link,
+                             const LoopLatencyMeter* loop, const SpectrumTap* spectrum,
+                             const CalibrationStore* cal, const CalibrationKey& cal_key, bool cal_seeded) {
+    std::ofstream ofs(path);
+    if (!ofs) return false;
+    JsonWriter j(ofs);
+    j.begin_object();
+    j.field("started", t.started);
+    write_config(j, opt, g);
+
+    j.begin_object("timing_s");
+    j.field("total", t.total_s);
+    j.field("open_radio", t.open_s);
+    j.field("configure", t.configure_s);
+    j.field("stream", t.stream_s);
+    j.field("write_output", t.output_s);
+    j.begin_object("startup");                        // up to the first RX sample
+    j.field("context", t.open.context_s);
+    j.field("discovery", t.open.discovery_s);
+    j.field("dds_off", t.open.dds_off_s);
+    j.field("configure", t.configure_s);
+    j.field("buffers", t.buffers_s);
+    j.field("first_sample", t.first_sample_s);
+    j.end_object();
+    j.begin_object("stream_stages");                  // summed over the run, per thread
+    j.field("tx_fill", st.tx_fill_ns * 1e-9);
+    j.field("buffer_push", st.push_lat.total() * 1e-9);
+    j.field("buffer_refill", st.refill_lat.total() * 1e-9);
+    j.field("rx_copy", st.rx_copy_ns * 1e-9);
+    j.field("link_analysis", st.analysis_ns * 1e-9);
+    j.field("marker_detect", st.marker_ns * 1e-9);
+    j.field("constellation", st.hist_ns * 1e-9);
+    j.field("spectrum", st.psd_ns * 1e-9);
+    j.field("shm_publish", st.shm_ns * 1e-9);
+    j.end_object();
+    j.end_object();
+
+    j.begin_object("throughput");
+    j.field("tx_samples", st.sent);
+    j.field("rx_samples", st.recv);
+    j.field("stream_seconds", st.seconds);
+    j.field("tx_samples_per_s", st.seconds > 0 ? st.sent / st.seconds : NAN);
+    j.field("rx_samples_per_s", st.seconds > 0 ? st.recv / st.seconds : NAN);
+    j.end_object();
+
+    auto latency = [&](const char* key, const LatencyHistogram& h) {
+        j.begin_object(key);
+        j.field("count", h.count());
+        j.field("p50_us", h.percentile(0.50) * 1e-3);
+        j.field("p99_us", h.percentile(0.99) * 1e-3);
+        j.field("p999_us", h.percentile(0.999) * 1e-3);
+        j.field("max_us", h.max() * 1e-3);
+        j.end_object();
+    };
+    j.begin_object("buffer_latency");
+    latency("push", st.push_lat);
+    latency("refill", st.refill_lat);
+    j.end_object();
+
+    j.begin_object("link");
+    j.field("locked", link.locked());
+    j.field("lag_samples", link.locked() ? double(link.lag()) : NAN);
+    j.field("phase_rad", link.locked() ? link.phase() : NAN);
+    j.field("dc_i", link.locked() ? link.dc_i() : NAN);
+    j.field("dc_q", link.locked() ? link.dc_q() : NAN);
+    j.field("bits", link.bits());
+    j.field("bit_errors", link.bit_errors());
+    write_rate(j, "ber", link.bit_errors(), link.bits());
+    j.field("symbols", link.symbols());
+    j.field("symbol_errors", link.symbol_errors());
+    write_rate(j, "ser", link.symbol_errors(), link.symbols());
+    j.field("skipped_samples", link.skipped());
+    j.field("snr_db", link.snr_db());
+    j.field("evm_rms", link.evm_rms());
+    j.field("image_rejection_db", link.image_rejection_db());
+    j.field("cfo_hz", link.cfo_cycles() * static_cast<double>(opt.sample_rate));
+    j.end_object();
+
+    if (cal) {
+        // The entry as saved after this run
+        const Calibration* c = cal->find(cal_key);
+        j.begin_object("calibration");
+        j.field("file", cal->path());
+        j.field("bucket", cal_key.text());
+        j.field("lag_from_cache", cal_seeded);
+        j.field("cached", c != nullptr);
+        if (c) {
+            j.field("lag_samples", static_cast<double>(c->lag));
+            j.field("runs", c->runs);
+        }
+        j.end_object();
+    }
+
+    j.begin_object("errors");
+    j.field("clipped_samples", link.clipped());
+    j.field("xflow_status_available", st.xflow_ok);
+    j.field("rx_overflows", st.rx_overflows);
+    j.field("tx_underflows", st.tx_underflows);
+    j.field("tx_reference_dropped", st.ref_dropped);
+    j.field("recording_dropped", st.rec_dropped);
+    j.field("spectrum_dropped", st.psd_dropped);
+    j.field("heap_allocations", st.heap_allocs);
+    j.end_object();
+
+    if (loop) {
+        const LatencyHistogram& lag = loop->lag_samples();
+        j.begin_object("loop_latency");
+        j.field("markers_detected", loop->detected());
+        j.field("markers_matched", loop->matched());
+        j.field("lag_samples_p50", lag.percentile(0.50));
+        j.field("lag_samples_max", lag.max());
+        latency("txbuf_to_rxbuf", loop->latency_ns());
+        j.end_object();
+    }
+    if (spectrum) {
+        const WelchPsd& p = spectrum->psd;
+        const size_t peak = p.peak_bin();
+        j.begin_object("spectrum");
+        j.field("nfft", p.nfft());
+        j.field("segments", p.frames());
+        j.field("bin_hz", spectrum->sample_rate / p.nfft());
+        j.field("occupied_bw_99_hz", p.occupied_bw(spectrum->sample_rate));
+        j.field("dc_dbfs", p.power_db(0));
+        j.field("peak_offset_hz", p.bin_hz(peak, spectrum->sample_rate));
+        j.field("peak_dbfs", p.power_db(peak));
+        j.end_object();
+    }
+    j.end_object();
+    j.finish();
+    return static_cast<bool>(ofs);
+}
+
+static bool write_stress_report(const std::string& path, const Options& opt, const GainReadback& g,
+                                const std::string& started, long long raw, long long processed) {
+    std::ofstream ofs(path);
+    if (!ofs) return false;
+    JsonWriter j(ofs);
+    j.begin_object();
+    j.field("started", started);
+    write_config(j, opt, g);
+    j.begin_object("stress");
+    j.field("seconds_per_step", opt.stress_seconds);
+    j.field("max_rate_raw", raw);
+    j.field("max_rate_with_processing", processed);
+    j.end_object();
+    j.end_object();
+    j.finish();
+    return static_cast<bool>(ofs);
+}
+
+// ---------- Calibration cache ----------
+static const size_t CAL_LAG_TOLERANCE = 64;     // searched first around a cached lag
+static const double CAL_MIN_SNR_DB = 3.0;       // weaker locks are not trusted to calibrate
+
+static CalibrationKey calibration_key(const Radio& r, long long rx_lo_hz, long long rate, const GainReadback& g,
+                                      size_t buf_samples) {
+    return calibration_key(r.serial, rx_lo_hz, rate, g.rx_mode, gain_db(g.rx_gain),
+                           static_cast<long long>(buf_samples));
+}
+
+// Starts the lag search around the cached lag; false if there is no entry.
+static bool seed_from_calibration(const CalibrationStore& cal, const CalibrationKey& k, LinkAnalyzer& link) {
+    const Calibration* c = cal.find(k);
+    if (!c) return false;
+    link.set_lag_hint(static_cast<size_t>(c->lag), CAL_LAG_TOLERANCE);
+    return true;
+}
+
+// A run that locked cleanly records its lag, and the file is saved in the
+// background. A run that did not lock leaves the entry alone: the search
+// fell back to the full range, so the cached lag was no obstacle.
+static void refresh_calibration(CalibrationStore& cal, const CalibrationKey& k, const LinkAnalyzer& link) {
+    if (!link.locked() || !(link.snr_db() >= CAL_MIN_SNR_DB)) return;
+    cal.update(k, static_cast<long long>(link.lag()), wall_ns() / 1000000000);
+    cal.save_async();
+}
+
+// ---------- Measurement campaigns ----------
+// Applies the settings of `p`; the attribute cache skips those that are
+// already set. Returns how many requests went to the device.
+static unsigned retune(Radio& r, const CampaignPoint& p) {
+    AttrCache& a = r.attrs;
+    unsigned requests = 0;
+    // Gains: unset means "as the radio has it", so only set values are written.
+    // The mode goes first: the AGC owns hardwaregain outside manual mode, so
+    // a changed mode invalidates the cached gain.
+    if (!p.rx_gain_mode.empty() && a.set(r.rx_bb, "gain_control_mode", p.rx_gain_mode)) {
+        a.forget(r.rx_bb, "hardwaregain");
+        requests += a.commit();
+    }
+    char val[32];
+    // rx_gain comes with gain_mode=manual (parse_campaign checks)
+    if (!std::isnan(p.rx_gain_db)) {
+        std::snprintf(val, sizeof(val), "%g", p.rx_gain_db);
+        a.set(r.rx_bb, "hardwaregain", val);
+    }
+    if (!std::isnan(p.tx_gain_db)) {
+        std::snprintf(val, sizeof(val), "%g", p.tx_gain_db);
+        a.set(r.tx_bb, "hardwaregain", val);
+    }
+    return requests + configure_radio(r, p.sample_rate, p.rf_bandwidth, p.rx_lo_hz, p.tx_lo_hz);
+}
+
+struct PointResult {
+    const CampaignPoint* point;
+    GainReadback gains;
+    uint64_t     attr_writes = 0;        // attribute values written
+    unsigned     attr_requests = 0;      // round trips they took
+    uint64_t     attr_skipped = 0;       // settings already in place
+    bool         new_buffers = false;
+    double       setup_s = 0;            // retune + buffer setup, up to the first sample
+    StreamStats  st;
+    bool         locked = false;
+    size_t       lag = 0;
+    uint64_t     clipped = 0, bits = 0, bit_errors = 0, symbols = 0, symbol_errors = 0;
+    double       snr_db = NAN, evm_rms = NAN;
+    double       irr_db = NAN, cfo_hz = NAN;
+    bool         cal_seeded = false;     // lag search seeded from --calibration
+};
+
+// The settings a point ran with; gains as read back.
+static void write_point_config(JsonWriter& j, const CampaignPoint& p, const GainReadback& g) {
+    j.begin_object("config");
+    j.field("sample_rate", p.sample_rate);
+    j.field("rf_bandwidth", p.rf_bandwidth);
+    j.field("rx_lo_hz", p.rx_lo_hz);
+    j.field("tx_lo_hz", p.tx_lo_hz);
+    j.field("rx_gain_control_mode", g.rx_mode);
+    j.field("rx_gain_db", gain_db(g.rx_gain));
+    j.field("tx_gain_db", gain_db(g.tx_gain));
+    j.field("modulation", p.modulation);
+    j.field("amp", p.amp);
+    j.field("buf_samples", p.buf_samples);
+    if (p.nsamples) j.field("nsamples", p.nsamples); else j.field("seconds", p.seconds);
+    j.end_object();
+}
+
+// Fields of one point's result object.
+static void write_point(JsonWriter& j, const PointResult& r) {
+    const CampaignPoint& p = *r.point;
+    j.field("name", p.name);
+    if (p.line) j.field("line", p.line);
+    write_point_config(j, p, r.gains);
+    j.begin_object("setup");
+    j.field("attr_writes", r.attr_writes);
+    j.field("attr_requests", r.attr_requests);
+    j.field("attr_skipped", r.attr_skipped);
+    j.field("new_buffers", r.new_buffers);
+    j.field("seconds", r.setup_s);
+    j.end_object();
+    j.field("stream_seconds", r.st.seconds);
+    j.field("rx_samples", r.st.recv);
+    j.field("tx_samples", r.st.sent);
+    j.field("locked", r.locked);
+    if (r.locked) j.field("lag_samples", r.lag); else j.null("lag_samples");
+    write_rate(j, "ber", r.bit_errors, r.bits);
+    write_rate(j, "ser", r.symbol_errors, r.symbols);
+    j.field("bits", r.bits);
+    j.field("snr_db", r.snr_db);
+    j.field("evm_rms", r.evm_rms);
+    j.field("image_rejection_db", r.irr_db);
+    j.field("cfo_hz", r.cfo_hz);
+    j.field("lag_from_calibration", r.cal_seeded);
+    j.field("clipped_samples", r.clipped);
+    if (r.st.xflow_ok) {
+        j.field("rx_overflows", r.st.rx_overflows);
+        j.field("tx_underflows", r.st.tx_underflows);
+    } else {
+        j.null("rx_overflows");
+        j.null("tx_underflows");
+    }
+}
+
+// Rewritten after every point, so an interrupted campaign keeps its results.
+static bool write_campaign_report(const std::string& path, const Options& opt, const std::string& started,
+                                  double open_s, size_t total_points, const std::vector<PointResult>& res) {
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream ofs(tmp);
+        if (!ofs) return false;
+        JsonWriter j(ofs);
+        j.begin_object();
+        j.field("started", started);
+        j.field("uri", opt.uri);
+        j.field("campaign", opt.campaign_path);
+        j.field("points_total", total_points);
+        j.field("open_radio_s", open_s);
+        j.begin_array("points");
+        for (const PointResult& r : res) {
+            j.begin_object();
+            write_point(j, r);
+            j.end_object();
+        }
+        j.end_array();
+        j.end_object();
+        j.finish();
+        if (!ofs) return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// Retunes to `p` (everything for the first point, then what changed since
+// `prev`), releasing the DMA buffers if their size or the rate changes.
+static void apply_point(Radio& radio, StreamBuffers& bufs, const CampaignPoint* prev, const CampaignPoint& p,
+                        PointResult& res) {
+    res.point = &p;
+    if (prev && (prev->sample_rate != p.sample_rate || prev->buf_samples != p.buf_samples))
+        release_buffers(radio, bufs);
+    const uint64_t writes = radio.attrs.writes(), skipped = radio.attrs.skipped();
+    res.attr_requests = retune(radio, p);
+    res.attr_writes = radio.attrs.writes() - writes;
+    res.attr_skipped = radio.attrs.skipped() - skipped;
+    res.gains = read_gains(radio);
+}
+
+static void take_link_results(const LinkAnalyzer& link, PointResult& res) {
+    res.locked = link.locked();
+    res.lag = link.lag();
+    res.clipped = link.clipped();
+    res.bits = link.bits();
+    res.bit_errors = link.bit_errors();
+    res.symbols = link.symbols();
+    res.symbol_errors = link.symbol_errors();
+    res.snr_db = link.snr_db();
+    res.evm_rms = link.evm_rms();
+    res.irr_db = link.image_rejection_db();
+    res.cfo_hz = link.cfo_cycles() * res.point->sample_rate;
+}
+
+static const size_t POINT_LAG_TOLERANCE = 64;   // search window around a point's lag hint
+
+// One measurement point: retune, make sure the buffers exist, stream and
+// analyze. The buffers stay up for the next point. `cal` (optional) seeds
+// the lag search unless the point has a lag and learns from the result.
+static void measure_point(Radio& radio, StreamBuffers& bufs, const StreamConfig& base,
+                          const CampaignPoint* prev, const CampaignPoint& p, CalibrationStore* cal,
+                          PointResult& res) {
+    const uint64_t t0 = mono_ns();
+    apply_point(radio, bufs, prev, p, res);
+
+    StreamConfig cfg = base;
+    cfg.nsamples = p.nsamples;
+    cfg.seconds = p.seconds;
+    cfg.rx_buf_samples = cfg.tx_buf_samples = p.buf_samples;
+    cfg.amp = static_cast<int16_t>(p.amp);
+    cfg.capture = false;
+    LinkAnalyzer link;
+    if (p.lag_hint >= 0) link.set_lag_hint(static_cast<size_t>(p.lag_hint), POINT_LAG_TOLERANCE);
+    const CalibrationKey key = calibration_key(radio, p.rx_lo_hz, p.sample_rate, res.gains, p.buf_samples);
+    if (cal && p.lag_hint < 0) res.cal_seeded = seed_from_calibration(*cal, key, link);
+    const unsigned created = bufs.created;
+    ensure_buffers(radio, bufs, cfg.rx_buf_samples, cfg.tx_buf_samples);
+    res.new_buffers = bufs.created != created;
+    res.setup_s = (mono_ns() - t0) * 1e-9;
+
+    Capture scratch;
+    run_stream(radio, bufs, cfg, scratch, &link, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, res.st);
+    take_link_results(link, res);
+    if (cal) refresh_calibration(*cal, key, link);
+}
+
+// One line per point on stdout.
+static std::string point_summary(const PointResult& res) {
+    const CampaignPoint& p = *res.point;
+    char line[224];
+    std::snprintf(line, sizeof(line),
+                  "%-12s rx_lo %.6g MHz  %.3f MSPS  setup %6.1f ms, %u req%s  BER %.3g  SNR %5.1f dB%s",
+                  p.name.c_str(), p.rx_lo_hz * 1e-6, p.sample_rate * 1e-6, res.setup_s * 1e3, res.attr_requests,
+                  res.new_buffers ? " (new buffers)" : "",
+                  res.locked && res.bits ? static_cast<double>(res.bit_errors) / res.bits : NAN, res.snr_db,
+                  res.locked ? "" : "  (no lock)");
+    return line;
+}
+
+// Runs every point of the campaign on the open radio. The context and
+// devices stay up for the whole campaign; between points only the changed
+// attributes are written, batched per channel, and the DMA buffers are kept unless the buffer
+// size or the sample rate changes.
+static void run_campaign(Radio& radio, const Options& opt, const StreamConfig& base,
+                         const std::vector<CampaignPoint>& points, CalibrationStore* cal,
+                         const std::string& started, double open_s) {
+    std::vector<PointResult> results;
+    results.reserve(points.size());
+    StreamBuffers bufs;
+    const CampaignPoint* prev = nullptr;
+    for (const CampaignPoint& p : points) {
+        TraceScope span("campaign_point");
+        PointResult res;
+        measure_point(radio, bufs, base, prev, p, cal, res);
+        results.push_back(res);
+        prev = &p;
+
+        std::cout << "[" << results.size() << "/" << points.size() << "] " << point_summary(res) << std::endl;
+        if (!opt.report_path.empty() &&
+            !write_campaign_report(opt.report_path, opt, started, open_s, points.size(), results))
+            fatal("Failed to write report " + opt.report_path);
+    }
+    release_buffers(radio, bufs);
+}
+
+// ---------- Measurement daemon ----------
+// Opens the radio once and takes commands on a Unix socket, one line each,
+// answering each with one line of JSON:
+//   configure key=value ...   apply settings (campaign point syntax) now
+//   run [key=value ...]       apply settings, measure, return the result
+//   status                    device, counters and the current settings
+//   shutdown                  stop the daemon
+// Settings persist from one command to the next. The DMA buffers stay up
+// between runs, so a run costs its airtime plus the attribute writes for
+// whatever changed. With --sim a simulated loopback (sim.hpp) stands in
+// for the Pluto.
+static std::atomic<bool> g_daemon_stop{false};
+
+static void on_daemon_signal(int) { g_daemon_stop = true; }
+
+// Gains a simulated run reports: what was asked for, as the driver formats it.
+static GainReadback sim_gains(const CampaignPoint& p) {
+    auto db = [](double v) { return std::isnan(v) ? std::string() : std::to_string(v) + " dB"; };
+    return {p.rx_gain_mode, db(p.rx_gain_db), db(p.tx_gain_db)};
+}
+
+static void simulate_point(SimLoopback& sim, const CampaignPoint& p, PointResult& res) {
+    res.point = &p;
+    res.gains = sim_gains(p);
+    const size_t n = p.nsamples ? p.nsamples : static_cast<size_t>(std::llround(p.seconds * p.sample_rate));
+    LinkAnalyzer link;
+    if (p.lag_hint >= 0) link.set_lag_hint(static_cast<size_t>(p.lag_hint), POINT_LAG_TOLERANCE);
+    sim.stream(n, p.buf_samples, static_cast<int16_t>(p.amp), link);
+    take_link_results(link, res);
+    res.st.sent = res.st.recv = n;
+    res.st.seconds = static_cast<double>(n) / p.sample_rate;   // airtime, not wall time
+}
+
+static std::string daemon_error(const std::string& what) {
+    std::ostringstream os;
+    JsonWriter j(os, true);
+    j.begin_object();
+    j.field("ok", false);
+    j.field("error", what);
+    j.end_object();
+    return os.str();
+}
+
+// radio == nullptr: simulated device.
+static void run_daemon(Radio* radio, const Options& opt, const StreamConfig& base, const CampaignPoint& initial,
+                       CalibrationStore* cal, const std::string& started, double open_s) {
+    ControlServer server;
+    const std::string err = server.listen(opt.serve_path);
+    if (!err.empty()) fatal("Could not open control socket: " + err);
+    std::signal(SIGINT, on_daemon_signal);
+    std::signal(SIGTERM, on_daemon_signal);
+
+    SimLoopback sim;
+    StreamBuffers bufs;
+    CampaignPoint current = initial;    // settings for the next command
+    CampaignPoint applied = initial;    // what the radio is set to
+    GainReadback gains = sim_gains(initial);
+    uint64_t runs = 0;
+    const uint64_t t_start = mono_ns();
+
+    // Tune and create the buffers up front so the first run is as cheap as
+    // the later ones
+    if (radio) {
+        PointResult res;
+        apply_point(*radio, bufs, nullptr, applied, res);
+        ensure_buffers(*radio, bufs, applied.buf_samples, applied.buf_samples);
+        gains = res.gains;
+    }
+    std::cout << "Serving on " << opt.serve_path << " (" << (radio ? opt.uri : std::string("simulated device"))
+              << ")" << std::endl;
+
+    auto handle = [&](const std::string& line, std::string& reply) {
+        TraceScope span("daemon_request");
+        const size_t sp = line.find_first_of(" \t");
+        const std::string cmd = line.substr(0, sp);
+        const std::string args = sp == std::string::npos ? "" : line.substr(sp + 1);
+        std::ostringstream os;
+        JsonWriter j(os, true);
+        if (cmd == "shutdown") {
+            j.begin_object().field("ok", true).end_object();
+            reply = os.str();
+            return false;
+        }
+        if (cmd == "status") {
+            j.begin_object();
+            j.field("ok", true);
+            j.field("device", radio ? opt.uri : std::string("sim"));
+            j.field("started", started);
+            j.field("uptime_s", (mono_ns() - t_start) * 1e-9);
+            j.field("open_radio_s", open_s);
+            j.field("runs", runs);
+            j.begin_object("buffers");
+            j.field("samples", bufs.rx ? bufs.rx_samples : 0);
+            j.field("created", bufs.created);
+            j.field("reused", bufs.reused);
+            j.end_object();
+            if (radio) {
+                j.begin_object("attributes");
+                j.field("writes", radio->attrs.writes());
+                j.field("requests", radio->attrs.requests());
+                j.field("skipped", radio->attrs.skipped());
+                j.end_object();
+            }
+            write_point_config(j, current, gains);
+            j.end_object();
+            reply = os.str();
+            return true;
+        }
+        if (cmd != "configure" && cmd != "run") {
+            reply = daemon_error("unknown command '" + cmd + "' (configure, run, status, shutdown)");
+            return true;
+        }
+        const std::string bad = apply_settings(current, args);
+        if (!bad.empty()) {
+            reply = daemon_error(bad);
+            return true;
+        }
+        PointResult res;
+        if (cmd == "configure") {
+            const uint64_t t0 = mono_ns();
+            if (radio) {
+                apply_point(*radio, bufs, &applied, current, res);
+                const unsigned created = bufs.created;
+                ensure_buffers(*radio, bufs, current.buf_samples, current.buf_samples);
+                res.new_buffers = bufs.created != created;
+            } else {
+                res.gains = sim_gains(current);
+            }
+            res.setup_s = (mono_ns() - t0) * 1e-9;
+            j.begin_object();
+            j.field("ok", true);
+            write_point_config(j, current, res.gains);
+            j.begin_object("setup");
+            j.field("attr_writes", res.attr_writes);
+            j.field("attr_requests", res.attr_requests);
+            j.field("attr_skipped", res.attr_skipped);
+            j.field("new_buffers", res.new_buffers);
+            j.field("seconds", res.setup_s);
+            j.end_object();
+            j.end_object();
+        } else {
+            if (radio) {
+                // RX kept filling its queue while the daemon sat idle
+                bufs.ready = false;
+                measure_point(*radio, bufs, base, &applied, current, cal, res);
+            } else {
+                simulate_point(sim, current, res);
+            }
+            runs++;
+            std::cout << "[run " << runs << "] " << point_summary(res) << std::endl;
+            j.begin_object();
+            j.field("ok", true);
+            j.field("run", runs);
+            write_point(j, res);
+            j.end_object();
+        }
+        applied = current;
+        gains = res.gains;
+        reply = os.str();
+        return true;
+    };
+    server.serve(handle, g_daemon_stop);
+    server.close();
+    if (radio) release_buffers(*radio, bufs);
+    std::cout << "Daemon stopped after " << runs << " runs" << std::endl;
+}
+
+// ---------- SigMF metadata ----------
+// The TX reference is not recorded: it is regenerated from the seed, and the
+// annotation says where it lines up with the RX samples.
+static SigmfMeta make_sigmf_meta(const Options& opt, const GainReadback& g,
+                                 const std::string& started, const LinkAnalyzer& link,
+                                 const StreamStats& st, uint64_t recorded) {
+    SigmfMeta m;
+    m.sample_rate  = static_cast<double>(opt.sample_rate);
+    m.frequency    = static_cast<double>(opt.rx_lo_hz);
+    m.datetime     = started;
+    m.description  = "PlutoSDR QPSK loopback, RX samples";
+    if (st.rec_dropped) m.description += " (recording truncated, RX continued)";
+    m.hw           = "PlutoSDR (AD9361) " + opt.uri;
+    m.rf_bandwidth = static_cast<double>(opt.rf_bandwidth);
+    m.tx_frequency = static_cast<double>(opt.tx_lo_hz);
+    m.rx_gain_mode = g.rx_mode;
+    m.rx_gain_db   = gain_db(g.rx_gain);
+    m.tx_gain_db   = gain_db(g.tx_gain);
+    m.tx_seed      = TX_SEED;
+    m.tx_amplitude = opt.amp;
+    if (link.locked() && link.lag() < recorded) {
+        SigmfAnnotation a;
+        a.sample_start = link.lag();
+        a.sample_count = std::min<uint64_t>(recorded - link.lag(), st.sent);
+        a.label = "qpsk_tx_reference";
+        char c[256];
+        std::snprintf(c, sizeof(c),
+                      "RX sample k+%zu carries TX symbol k (I then Q bit per symbol from "
+                      "mt19937 seed %llu, +/-%d). BER %.3g over %llu bits, SNR %.2f dB",
+                      link.lag(), static_cast<unsigned long long>(m.tx_seed), opt.amp, link.ber(),
+                      static_cast<unsigned long long>(link.bits()), link.snr_db());
+        a.comment = c;
+        m.annotations.push_back(a);
+    }
+    return m;
+}
+
+// Schema metadata of the Arrow output: the run settings and link result.
+static ArrowMetadata make_arrow_meta(const Options& opt, const GainReadback& g,
+                                     const std::string& started, const LinkAnalyzer& link) {
+    ArrowMetadata m = {
+        {"started", started},
+        {"hw", "PlutoSDR (AD9361) " + opt.uri},
+        {"sample_rate", std::to_string(opt.sample_rate)},
+        {"rf_bandwidth", std::to_string(opt.rf_bandwidth)},
+        {"rx_lo_hz", std::to_string(opt.rx_lo_hz)},
+        {"tx_lo_hz", std::to_string(opt.tx_lo_hz)},
+        {"rx_gain_control_mode", g.rx_mode},
+        {"rx_gain_db", g.rx_gain},
+        {"tx_gain_db", g.tx_gain},
+        {"tx_prng", "mt19937"},
+        {"tx_seed", std::to_string(TX_SEED)},
+        {"tx_amplitude", std::to_string(opt.amp)},
+    };
+    if (link.locked()) {
+        char ber[32], snr[32];
+        std::snprintf(ber, sizeof(ber), "%.6g", link.ber());
+        std::snprintf(snr, sizeof(snr), "%.3f", link.snr_db());
+        m.push_back({"lag_samples", std::to_string(link.lag())});
+        m.push_back({"ber", ber});
+        m.push_back({"bits", std::to_string(link.bits())});
+        m.push_back({"snr_db", snr});
+    }
+    return m;
+}
+
+int main(int argc, char** argv) {
+    const Options opt = parse_options(argc, argv);
+    RunTimings timings;
+    timings.started = utc_now();
+    const uint64_t t_main = mono_ns();
+    uint64_t t_phase = t_main;
+    auto phase_done = [&](double& out) {
+        const uint64_t now = mono_ns();
+        out = (now - t_phase) * 1e-9;
+        t_phase = now;
+    };
+
+    // ---------- User settings ----------
+    const char*     URI          = opt.uri.c_str();
+    const long long SAMPLE_RATE  = opt.sample_rate;
+    const long long RF_BANDWIDTH = opt.rf_bandwidth;
+    const long long RX_LO_HZ     = opt.rx_lo_hz;
+    const long long TX_LO_HZ     = opt.tx_lo_hz;
+    const size_t    NSAMPLES     = opt.nsamples;    // complex samples to send/receive
+    const std::string CSV_PATH   = opt.csv_path;
+
+    StreamConfig cfg;
+    cfg.nsamples       = NSAMPLES;
+    cfg.rx_buf_samples = opt.buf_samples;
+    cfg.tx_buf_samples = opt.buf_samples;
+    cfg.amp            = static_cast<int16_t>(opt.amp);
+    cfg.rt_priority    = opt.rt_priority;
+    cfg.tx_cpu         = opt.tx_cpu;
+    cfg.rx_cpu         = opt.rx_cpu;
+    cfg.prefault       = opt.mlock;
+    cfg.hugepages      = opt.hugepages;
+    cfg.check_alloc    = opt.check_alloc;
+
+    // ---------- Real-time memory ----------
+    if (opt.mlock) {
+        const std::string err = lock_memory();
+        if (!err.empty()) fatal(err);
+    }
+
+    // Spans per thread kept for the trace; older ones are overwritten
+    const size_t TRACE_EVENTS = 1u << 18;
+    if (!opt.trace_path.empty()) tracer().enable(TRACE_EVENTS);
+    tracer().register_thread("main");
+    auto dump_trace = [&] {
+        if (opt.trace_path.empty()) return;
+        if (!tracer().dump(opt.trace_path)) fatal("Failed to write trace " + opt.trace_path);
+        std::cout << "Wrote trace " << opt.trace_path << std::endl;
+    };
+
+    // Campaign points and daemon commands start from the command-line settings
+    const CampaignPoint defaults = point_defaults(opt);
+
+    // Read the whole campaign before touching the radio
+    std::vector<CampaignPoint> points;
+    if (!opt.campaign_path.empty()) {
+        const std::string err = parse_campaign(opt.campaign_path, defaults, points);
+        if (!err.empty()) fatal(err);
+    }
+
+    // ---------- Calibration cache ----------
+    CalibrationStore calibration;
+    CalibrationStore* cal = nullptr;
+    if (!opt.calibration_path.empty()) {
+        const std::string err = calibration.load(opt.calibration_path);
+        if (!err.empty()) std::cout << "Warning: " << err << "; the entries after it are dropped." << std::endl;
+        cal = &calibration;
+    }
+    auto finish_calibration = [&] {
+        if (!cal) return;
+        const std::string err = calibration.wait();
+        if (!err.empty()) std::cout << "Warning: calibration cache not saved: " << err << std::endl;
+    };
+
+    if (!opt.serve_path.empty()) {
+        Radio radio;
+        if (!opt.sim) radio = open_radio(URI, timings.open);
+        phase_done(timings.open_s);
+        run_daemon(opt.sim ? nullptr : &radio, opt, cfg, defaults, cal, timings.started, timings.open_s);
+        close_radio(radio);
+        finish_calibration();
+        dump_trace();
+        return 0;
+    }
+
+    Radio radio = open_radio(URI, timings.open);
+    phase_done(timings.open_s);
+
+    if (!points.empty()) {
+        std::cout << "Campaign " << opt.campaign_path << ": " << points.size() << " points" << std::endl;
+        run_campaign(radio, opt, cfg, points, cal, timings.started, timings.open_s);
+        close_radio(radio);
+        finish_calibration();
+        std::cout << "Campaign done in " << (mono_ns() - t_main) * 1e-9 << " s" << std::endl;
+        if (!opt.report_path.empty()) std::cout << "Wrote report " << opt.report_path << std::endl;
+        dump_trace();
+        return 0;
+    }
+
+    if (opt.stress) {
+        std::cout << "Raw streaming, " << opt.stress_seconds << " s per step:" << std::endl;
+        const long long raw = stress_sweep(radio, cfg, RX_LO_HZ, TX_LO_HZ, opt.stress_seconds, nullptr);
+        StressLoad load;
+        load.latency       = opt.latency;
+        load.constellation = !opt.constellation_path.empty();
+        load.psd_nfft      = opt.psd_path.empty() ? 0 : opt.psd_nfft;
+        load.shm_name      = opt.shm_name;
+        load.shm_samples   = opt.shm_samples;
+        load.record_path   = opt.sigmf_base.empty() ? "" : opt.sigmf_base + (opt.pack ? ".bcap" : ".sigmf-data");
+        load.pack          = opt.pack;
+        std::cout << "With " << load.describe() << ":" << std::endl;
+        const long long proc = stress_sweep(radio, cfg, RX_LO_HZ, TX_LO_HZ, opt.stress_seconds, &load);
+        const GainReadback gains = read_gains(radio);
+        close_radio(radio);
+        std::cout << "Max sustainable rate: raw " << raw * 1e-6 << " MSPS, with processing "
+                  << proc * 1e-6 << " MSPS" << std::endl;
+        if (!opt.report_path.empty() &&
+            !write_stress_report(opt.report_path, opt, gains, timings.started, raw, proc))
+            fatal("Failed to write report " + opt.report_path);
+        dump_trace();
+        return 0;
+    }
+
+    configure_radio(radio, SAMPLE_RATE, RF_BANDWIDTH, RX_LO_HZ, TX_LO_HZ);
+    const GainReadback gains = read_gains(radio);
+    phase_done(timings.configure_s);
+
+    // ---------- Live link statistics and metrics endpoint ----------
+    LinkAnalyzer link;
+    const size_t LAG_TOLERANCE = 64;     // search window around --lag
+    if (opt.lag_hint >= 0) link.set_lag_hint(static_cast<size_t>(opt.lag_hint), LAG_TOLERANCE);
+    const CalibrationKey cal_key = calibration_key(radio, RX_LO_HZ, SAMPLE_RATE, gains, opt.buf_samples);
+    bool cal_seeded = false;
+    if (cal && opt.lag_hint < 0) {
+        cal_seeded = seed_from_calibration(calibration, cal_key, link);
+        if (cal_seeded) {
+            const Calibration* c = calibration.find(cal_key);
+            std::cout << "Calibration: searching around lag " << c->lag << " first (from " << c->runs
+                      << " earlier run" << (c->runs == 1 ? "" : "s") << ")" << std::endl;
+        } else {
+            std::cout << "Calibration: no entry for " << cal_key.text() << ", full lag search" << std::endl;
+        }
+    }
+    LoopLatencyMeter loop(cfg.amp, static_cast<double>(SAMPLE_RATE));
+    Metrics metrics;
+    IqHistogram hist;
+    SpectrumTap spectrum{WelchPsd(opt.psd_nfft), opt.psd_path, opt.psd_interval,
+                         static_cast<double>(SAMPLE_RATE), static_cast<double>(RX_LO_HZ)};
+    ShmRingWriter live;
+    if (!opt.shm_name.empty()) {
+        const std::string err = live.create(opt.shm_name, opt.shm_samples, static_cast<double>(SAMPLE_RATE),
+                                            static_cast<double>(RX_LO_HZ));
+        if (!err.empty()) fatal("Could not create live ring: " + err);
+        std::cout << "Live RX samples in shared memory " << opt.shm_name << " (" << live.capacity()
+                  << " samples)" << std::endl;
+    }
+    MetricsServer metrics_server;
+    if (opt.metrics_port > 0) {
+        if (!metrics_server.start(opt.metrics_port, metrics))
+            fatal("Could not start metrics endpoint on port " + std::to_string(opt.metrics_port));
+        std::cout << "Metrics at http://127.0.0.1:" << opt.metrics_port << "/metrics" << std::endl;
+    }
+
+    // ---------- SigMF recording (replaces the CSV) ----------
+    const bool SIGMF = !opt.sigmf_base.empty();
+    // The recording streams to disk and replaces the CSV/Feather output, so
+    // the pools only need to hold the blocks in flight
+    if (SIGMF) cfg.capture = false;
+    const std::string DATA_PATH = opt.sigmf_base + (opt.pack ? ".bcap" : ".sigmf-data");
+    SigmfDataWriter rec;
+    CaptureWriter packed;
+    SampleSink* sink = nullptr;
+    if (SIGMF) {
+        const std::string err = opt.pack ? packed.open(DATA_PATH, SAMPLE_RATE) : rec.open(DATA_PATH);
+        if (!err.empty()) fatal("Could not open recording " + err);
+        sink = opt.pack ? static_cast<SampleSink*>(&packed) : &rec;
+    }
+
+    Capture cap;
+    StreamStats st;
+    t_phase = mono_ns();
+    StreamBuffers bufs;
+    ensure_buffers(radio, bufs, cfg.rx_buf_samples, cfg.tx_buf_samples);
+    phase_done(timings.buffers_s);
+    run_stream(radio, bufs, cfg, cap, &link, opt.latency ? &loop : nullptr, &metrics,
+               opt.constellation_path.empty() ? nullptr : &hist,
+               opt.psd_path.empty() ? nullptr : &spectrum, live.is_open() ? &live : nullptr, sink, st);
+    phase_done(timings.stream_s);
+    if (st.first_rx_ns) timings.first_sample_s = (st.first_rx_ns - t_main) * 1e-9;
+    release_buffers(radio, bufs);
+    metrics_server.stop();
+    live.close();
+
+    std::string written;
+    if (SIGMF) {
+        TraceScope span("sigmf_meta");
+        const std::string err = opt.pack ? packed.close() : rec.close();
+        if (!err.empty()) fatal("Failed to write recording: " + err);
+        const uint64_t recorded = opt.pack ? packed.samples() : rec.samples();
+        SigmfMeta meta = make_sigmf_meta(opt, gains, timings.started, link, st, recorded);
+        if (opt.pack) {
+            const size_t slash = DATA_PATH.find_last_of('/');
+            meta.dataset  = (slash == std::string::npos) ? DATA_PATH : DATA_PATH.substr(slash + 1);
+            meta.encoding = "bcap2: indexed blocks of 12-bit packed or Rice-coded I/Q (capture_tool decode)";
+        }
+        if (!write_sigmf_meta(opt.sigmf_base + ".sigmf-meta", meta))
+            fatal("Failed to write " + opt.sigmf_base + ".sigmf-meta");
+        written = DATA_PATH + " with " + std::to_string(recorded);
+    } else if (!opt.feather_path.empty()) {
+        // ---------- Write Arrow IPC: int16 tx_i,tx_q,rx_i,rx_q ----------
+        TraceScope span("feather_write");
+        const std::vector<ArrowColumn> cols = {
+            {"tx_i", cap.tx.i(), cap.tx.size()}, {"tx_q", cap.tx.q(), cap.tx.size()},
+            {"rx_i", cap.rx.i(), cap.rx.size()}, {"rx_q", cap.rx.q(), cap.rx.size()}};
+        const std::string err = write_arrow_ipc(opt.feather_path, NSAMPLES, cols,
+                                                make_arrow_meta(opt, gains, timings.started, link));
+        if (!err.empty()) fatal("Failed to write " + err);
+        written = opt.feather_path + " with " + std::to_string(NSAMPLES);
+    } else {
+        // ---------- Write CSV (raw only): n,tx_i,tx_q,rx_i,rx_q ----------
+        TraceScope span("csv_write");
+        if (!write_csv(CSV_PATH, NSAMPLES, cap.tx.i(), cap.tx.q(), cap.tx.size(),
+                       cap.rx.i(), cap.rx.q(), cap.rx.size()))
+            fatal("Failed to write CSV");
+        written = CSV_PATH + " with " + std::to_string(NSAMPLES);
+    }
+    if (!opt.constellation_path.empty() && !hist.write(opt.constellation_path))
+        fatal("Failed to write " + opt.constellation_path);
+    if (!opt.psd_path.empty() && !spectrum.write())
+        fatal("Failed to write " + opt.psd_path);
+    phase_done(timings.output_s);
 
     // ---------- Destroy context ----------
-    iio_context_destroy(ctx);
+    close_radio(radio);
 
-    std::cout << "Done. Wrote " << CSV_PATH
-              << " with " << NSAMPLES << " samples." << std::endl;
+    std::cout << "Done. Wrote " << written << " samples." << std::endl;
+    {
+        const OpenTimes& o = timings.open;
+        char line[224];
+        std::snprintf(line, sizeof(line),
+                      "Startup: context %.1f ms, discovery %.2f ms, DDS off %.1f ms, configure %.1f ms, "
+                      "buffers %.1f ms; first RX sample %.1f ms after start",
+                      o.context_s * 1e3, o.discovery_s * 1e3, o.dds_off_s * 1e3,
+                      timings.configure_s * 1e3, timings.buffers_s * 1e3, timings.first_sample_s * 1e3);
+        std::cout << line << std::endl;
+    }
+    st.push_lat.print_summary(std::cout, "iio_buffer_push");
+    st.refill_lat.print_summary(std::cout, "iio_buffer_refill");
+    if (link.locked()) {
+        std::cout << "Link: lag=" << link.lag() << " samples, BER=" << link.ber()
+                  << " (" << link.bit_errors() << "/" << link.bits() << "), SNR="
+                  << link.snr_db() << " dB\n";
+    } else {
+        std::cout << "Link: no TX->RX alignment found, BER not measured\n";
+    }
+    std::cout << "Clipped RX samples: " << link.clipped();
+    if (st.xflow_ok) std::cout << ", RX overflows: " << st.rx_overflows
+                               << ", TX underflows: " << st.tx_underflows;
+    std::cout << std::endl;
+    if (opt.hugepages && !cap.rx.on_hugepages())
+        std::cout << "Note: no hugepages available, sample pools use normal pages." << std::endl;
+    if (opt.check_alloc)
+        std::cout << "Heap allocations while streaming: " << st.heap_allocs << std::endl;
+    if (SIGMF && opt.pack && packed.samples()) {
+        char line[160];
+        std::snprintf(line, sizeof(line),
+                      "Packed capture: %.1f%% of ci16 size (%llu 12-bit, %llu Rice blocks)",
+                      100.0 * packed.bytes() / (4.0 * packed.samples()),
+                      static_cast<unsigned long long>(packed.pack12_blocks()),
+                      static_cast<unsigned long long>(packed.rice_blocks()));
+        std::cout << line << std::endl;
+    }
+    if (st.rec_dropped)
+        std::cout << "Warning: recording fell behind; the last " << st.rec_dropped
+                  << " RX samples are not in it." << std::endl;
+    if (st.ref_dropped)
+        std::cout << "Warning: " << st.ref_dropped << " TX reference symbols did not reach "
+                     "the analyzer; BER covers only the samples before that." << std::endl;
+    if (!opt.psd_path.empty() && spectrum.psd.frames()) {
+        const WelchPsd& p = spectrum.psd;
+        const size_t peak = p.peak_bin();
+        char line[200];
+        std::snprintf(line, sizeof(line),
+                      "Spectrum: %llu segments, 99%% occupied bandwidth %.0f Hz, DC %.1f dBFS, "
+                      "strongest bin %+.0f Hz at %.1f dBFS",
+                      static_cast<unsigned long long>(p.frames()), p.occupied_bw(spectrum.sample_rate),
+                      p.power_db(0), p.bin_hz(peak, spectrum.sample_rate), p.power_db(peak));
+        std::cout << line << std::endl;
+    }
+    if (st.psd_dropped)
+        std::cout << "Note: the spectrum thread fell behind and skipped " << st.psd_dropped
+                  << " RX samples." << std::endl;
+    if (opt.latency) print_loop_latency(loop);
+    if (cal) refresh_calibration(calibration, cal_key, link);
+    timings.total_s = (mono_ns() - t_main) * 1e-9;
+    if (!opt.report_path.empty()) {
+        if (!write_run_report(opt.report_path, opt, gains, timings, st, link,
+                              opt.latency ? &loop : nullptr,
+                              opt.psd_path.empty() ? nullptr : &spectrum, cal, cal_key, cal_seeded))
+            fatal("Failed to write report " + opt.report_path);
+        std::cout << "Wrote report " << opt.report_path << std::endl;
+    }
+    finish_calibration();
+    dump_trace();
     return 0;
 }
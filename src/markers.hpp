@@ -0,0 +1,205 @@
+// TX->RX loop latency from markers embedded in the TX stream.
+//
+// A marker is MARKER_LEN QPSK symbols: a PN half-preamble sent twice
+// (Schmidl-Cox style, so RX can find it with an O(1)-per-sample running
+// autocorrelation), then a 16-bit id on I with its complement on Q. TX
+// records (id -> TX sample index, write time); RX detects the marker,
+// refines its start with a short cross-correlation, decodes the id and
+// pairs it with the TX record.
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include "latency.hpp"
+
+constexpr size_t MARKER_HALF     = 32;                   // PN symbols per half
+constexpr size_t MARKER_PREAMBLE = 2 * MARKER_HALF;
+constexpr size_t MARKER_ID_SYMS  = 16;
+constexpr size_t MARKER_LEN      = MARKER_PREAMBLE + MARKER_ID_SYMS;
+
+// Marker symbols for `id` at amplitude ±amp (I and Q arrays of MARKER_LEN).
+inline void marker_symbols(uint16_t id, int16_t amp, int16_t* i, int16_t* q) {
+    uint8_t lfsr = 0x5A;                               // PRBS7: x^7 + x^6 + 1
+    for (size_t k = 0; k < MARKER_HALF; ++k) {
+        const int bi = ((lfsr >> 6) ^ (lfsr >> 5)) & 1;
+        lfsr = static_cast<uint8_t>(((lfsr << 1) | bi) & 0x7F);
+        const int bq = ((lfsr >> 6) ^ (lfsr >> 5)) & 1;
+        lfsr = static_cast<uint8_t>(((lfsr << 1) | bq) & 0x7F);
+        i[k] = i[k + MARKER_HALF] = bi ? amp : static_cast<int16_t>(-amp);
+        q[k] = q[k + MARKER_HALF] = bq ? amp : static_cast<int16_t>(-amp);
+    }
+    for (size_t k = 0; k < MARKER_ID_SYMS; ++k) {
+        const int b = (id >> k) & 1;
+        i[MARKER_PREAMBLE + k] = b ? amp : static_cast<int16_t>(-amp);
+        q[MARKER_PREAMBLE + k] = b ? static_cast<int16_t>(-amp) : amp;   // complement
+    }
+}
+
+class LoopLatencyMeter {
+public:
+    // amp: TX marker amplitude; sample_rate converts sample lag to time.
+    LoopLatencyMeter(int16_t amp, double sample_rate) : sample_rate_(sample_rate) {
+        marker_symbols(0, amp, ref_i_, ref_q_);
+    }
+
+    // ---- TX side: a marker with this id starts at TX sample `tx_index` ----
+    // Safe to call from a different thread than push_rx().
+    void on_tx_marker(uint16_t id, uint64_t tx_index, uint64_t t_ns) {
+        Slot& s = slots_[id % NSLOTS];
+        s.id.store(UINT32_MAX, std::memory_order_relaxed);
+        s.tx_index.store(tx_index, std::memory_order_relaxed);
+        s.t_ns.store(t_ns, std::memory_order_relaxed);
+        s.id.store(id, std::memory_order_release);
+    }
+
+    // ---- RX side: samples in arrival order, t_ns = when they became visible ----
+    void push_rx(const int16_t* i, const int16_t* q, size_t n, uint64_t t_ns) {
+        if (n == 0) return;
+        update_dc(i, q, n);
+        for (size_t k = 0; k < n; ++k) step(i[k] - dc_i_, q[k] - dc_q_, t_ns);
+    }
+
+    size_t detected() const { return detected_; }
+    size_t matched()  const { return matched_; }
+    // TX->RX offset in stream samples; the starting lag for BER alignment.
+    const LatencyHistogram& lag_samples() const { return lag_; }
+    // Wall time from writing the marker into txbuf to reading it from rxbuf.
+    const LatencyHistogram& latency_ns()  const { return lat_; }
+    double sample_rate() const { return sample_rate_; }
+
+private:
+    static constexpr size_t   RING   = 256;     // >= FINE + MARKER_LEN + 2 * MARKER_HALF
+    static constexpr size_t   NSLOTS = 1024;
+    static constexpr long     FINE   = 8;       // cross-correlation search half-width
+    static constexpr double   THRESH = 0.6;     // Schmidl-Cox metric threshold
+
+    struct Slot {
+        std::atomic<uint32_t> id{UINT32_MAX};
+        std::atomic<uint64_t> tx_index{0};
+        std::atomic<uint64_t> t_ns{0};
+    };
+
+    enum class State { Idle, Tracking, Fine };
+
+    // DC estimate tracked per block (first block sets it). Ring entries keep
+    // the DC that was removed when they arrived, so the running sums stay exact.
+    void update_dc(const int16_t* i, const int16_t* q, size_t n) {
+        int64_t si = 0, sq = 0;
+        for (size_t k = 0; k < n; ++k) { si += i[k]; sq += q[k]; }
+        const double mi = double(si) / n, mq = double(sq) / n;
+        if (!dc_init_) { dcf_i_ = mi; dcf_q_ = mq; dc_init_ = true; }
+        else { dcf_i_ += (mi - dcf_i_) / 8; dcf_q_ += (mq - dcf_q_) / 8; }
+        dc_i_ = static_cast<int32_t>(std::lround(dcf_i_));
+        dc_q_ = static_cast<int32_t>(std::lround(dcf_q_));
+    }
+
+    int32_t xi(uint64_t abs) const { return ri_[abs % RING]; }
+    int32_t xq(uint64_t abs) const { return rq_[abs % RING]; }
+
+    void step(int32_t vi, int32_t vq, uint64_t t_ns) {
+        const uint64_t n = n_++;
+        ri_[n % RING] = vi;
+        rq_[n % RING] = vq;
+        const size_t L = MARKER_HALF;
+
+        // Running autocorrelation between the two halves of the last 2L
+        // samples. Slots older than the stream start are still zero.
+        const int32_t ai = vi, aq = vq;                                  // x[n]
+        const int32_t bi = n >= L ? xi(n - L) : 0, bq = n >= L ? xq(n - L) : 0;
+        const int32_t ci = n >= 2 * L ? xi(n - 2 * L) : 0, cq = n >= 2 * L ? xq(n - 2 * L) : 0;
+        // P += x[n] conj(x[n-L]) - x[n-L] conj(x[n-2L])
+        p_re_ += int64_t(ai) * bi + int64_t(aq) * bq - (int64_t(bi) * ci + int64_t(bq) * cq);
+        p_im_ += int64_t(aq) * bi - int64_t(ai) * bq - (int64_t(bq) * ci - int64_t(bi) * cq);
+        e2_ += int64_t(ai) * ai + int64_t(aq) * aq - (int64_t(bi) * bi + int64_t(bq) * bq);
+        e1_ += int64_t(bi) * bi + int64_t(bq) * bq - (int64_t(ci) * ci + int64_t(cq) * cq);
+        if (n + 1 < 2 * L) return;
+
+        const uint64_t m = n + 1 - 2 * L;           // window start
+        const double den = double(e1_) * double(e2_);
+        const double metric = den > 0 ? (double(p_re_) * p_re_ + double(p_im_) * p_im_) / den : 0;
+
+        switch (state_) {
+        case State::Idle:
+            if (metric > THRESH && m >= hold_until_) {
+                state_ = State::Tracking;
+                best_metric_ = metric;
+                best_m_ = m;
+            }
+            break;
+        case State::Tracking:
+            if (metric > best_metric_) { best_metric_ = metric; best_m_ = m; }
+            if (m >= best_m_ + L) state_ = State::Fine;
+            break;
+        case State::Fine:
+            if (n >= best_m_ + FINE + MARKER_LEN) {
+                refine(t_ns);
+                state_ = State::Idle;
+            }
+            break;
+        }
+    }
+
+    // Exact start by cross-correlating the preamble around the coarse peak,
+    // then decode the id and pair it with the TX record.
+    void refine(uint64_t t_ns) {
+        long best_off = 0;
+        double best = -1, g_re = 0, g_im = 0;
+        for (long off = -FINE; off <= FINE; ++off) {
+            if (off < 0 && best_m_ < static_cast<uint64_t>(-off)) continue;
+            const uint64_t s = best_m_ + off;
+            int64_t cr = 0, ci = 0;
+            for (size_t k = 0; k < MARKER_PREAMBLE; ++k) {
+                const int32_t x_i = xi(s + k), x_q = xq(s + k);
+                cr += int64_t(x_i) * ref_i_[k] + int64_t(x_q) * ref_q_[k];
+                ci += int64_t(x_q) * ref_i_[k] - int64_t(x_i) * ref_q_[k];
+            }
+            const double mag = double(cr) * cr + double(ci) * ci;
+            if (mag > best) { best = mag; best_off = off; g_re = double(cr); g_im = double(ci); }
+        }
+        const uint64_t start = best_m_ + best_off;
+        hold_until_ = start + MARKER_LEN;
+        detected_++;
+
+        // Derotate by the channel phase: z = x * conj(g)
+        uint16_t id = 0, nid = 0;
+        for (size_t k = 0; k < MARKER_ID_SYMS; ++k) {
+            const double x_i = xi(start + MARKER_PREAMBLE + k);
+            const double x_q = xq(start + MARKER_PREAMBLE + k);
+            const double zi = x_i * g_re + x_q * g_im;
+            const double zq = x_q * g_re - x_i * g_im;
+            if (zi > 0) id  |= static_cast<uint16_t>(1u << k);
+            if (zq < 0) nid |= static_cast<uint16_t>(1u << k);
+        }
+        if (id != nid) return;                 // corrupted id
+
+        const Slot& s = slots_[id % NSLOTS];
+        if (s.id.load(std::memory_order_acquire) != id) return;
+        const uint64_t tx_index = s.tx_index.load(std::memory_order_relaxed);
+        const uint64_t tx_t     = s.t_ns.load(std::memory_order_relaxed);
+        if (start < tx_index || t_ns < tx_t) return;
+        matched_++;
+        lag_.record(start - tx_index);
+        lat_.record(t_ns - tx_t);
+    }
+
+    double sample_rate_;
+    int16_t ref_i_[MARKER_LEN], ref_q_[MARKER_LEN];   // preamble reference (id part unused)
+    Slot slots_[NSLOTS];
+
+    int32_t ri_[RING] = {}, rq_[RING] = {};
+    uint64_t n_ = 0;
+    int64_t p_re_ = 0, p_im_ = 0, e1_ = 0, e2_ = 0;
+    bool dc_init_ = false;
+    double dcf_i_ = 0, dcf_q_ = 0;
+    int32_t dc_i_ = 0, dc_q_ = 0;
+
+    State state_ = State::Idle;
+    double best_metric_ = 0;
+    uint64_t best_m_ = 0, hold_until_ = 0;
+    size_t detected_ = 0, matched_ = 0;
+    LatencyHistogram lag_, lat_;
+};
@@ -0,0 +1,178 @@
+// Live run metrics in Prometheus text format, served over plain HTTP on
+// 127.0.0.1. The streaming loop only stores into relaxed atomics; the
+// server thread reads them when scraped, so a slow scraper never stalls
+// the radio.
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "latency.hpp"
+
+struct Metrics {
+    // Counters (monotonic)
+    std::atomic<uint64_t> tx_samples{0};
+    std::atomic<uint64_t> rx_samples{0};
+    std::atomic<uint64_t> bits{0};
+    std::atomic<uint64_t> bit_errors{0};
+    std::atomic<uint64_t> clipped_samples{0};
+    std::atomic<uint64_t> rx_overflows{0};
+    std::atomic<uint64_t> tx_underflows{0};
+
+    // Gauges
+    std::atomic<double> throughput_sps{0.0};
+    std::atomic<double> ber{NAN};
+    std::atomic<double> snr_db{NAN};
+
+    // Summaries: latency quantiles, sum and count in seconds/calls,
+    // quantile index matches QUANTILES
+    static constexpr double QUANTILES[4] = {0.5, 0.99, 0.999, 1.0};
+    struct LatencySummary {
+        std::atomic<double>   quantile[4] = {};
+        std::atomic<double>   sum{0.0};
+        std::atomic<uint64_t> count{0};
+    };
+    LatencySummary push_latency;
+    LatencySummary refill_latency;
+
+    // Copy a histogram's quantiles, sum and count into one of the latency
+    // summaries. Walks the histogram, so callers do it at a throttled rate,
+    // from the thread that owns the histogram.
+    static void publish_latency(const LatencyHistogram& h, LatencySummary& out) {
+        for (int k = 0; k < 4; ++k) {
+            const double q = QUANTILES[k];
+            const uint64_t v = (q >= 1.0) ? h.max() : h.percentile(q);
+            out.quantile[k].store(v * 1e-9, std::memory_order_relaxed);
+        }
+        out.sum.store(h.total() * 1e-9, std::memory_order_relaxed);
+        out.count.store(h.count(), std::memory_order_relaxed);
+    }
+
+    std::string render() const {
+        std::string out;
+        auto counter = [&](const char* name, const char* help, const std::atomic<uint64_t>& v) {
+            char line[256];
+            std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+                          name, help, name, name,
+                          static_cast<unsigned long long>(v.load(std::memory_order_relaxed)));
+            out += line;
+        };
+        auto gauge = [&](const char* name, const char* help, const std::atomic<double>& v) {
+            char line[256];
+            std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s gauge\n%s %.9g\n",
+                          name, help, name, name, v.load(std::memory_order_relaxed));
+            out += line;
+        };
+        auto summary = [&](const char* name, const char* help, const LatencySummary& v) {
+            char line[256];
+            std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s summary\n", name, help, name);
+            out += line;
+            for (int k = 0; k < 4; ++k) {
+                std::snprintf(line, sizeof(line), "%s{quantile=\"%g\"} %.9g\n",
+                              name, QUANTILES[k], v.quantile[k].load(std::memory_order_relaxed));
+                out += line;
+            }
+            std::snprintf(line, sizeof(line), "%s_sum %.9g\n%s_count %llu\n",
+                          name, v.sum.load(std::memory_order_relaxed), name,
+                          static_cast<unsigned long long>(v.count.load(std::memory_order_relaxed)));
+            out += line;
+        };
+        counter("ber_tx_samples_total", "Complex samples pushed to the TX buffer.", tx_samples);
+        counter("ber_rx_samples_total", "Complex samples read from the RX buffer.", rx_samples);
+        counter("ber_bits_total", "Bits compared against the TX reference.", bits);
+        counter("ber_bit_errors_total", "Hard-decision bit errors.", bit_errors);
+        counter("ber_clipped_samples_total", "RX samples at ADC full scale.", clipped_samples);
+        counter("ber_rx_overflows_total", "RX DMA overflow events.", rx_overflows);
+        counter("ber_tx_underflows_total", "TX DMA underflow events.", tx_underflows);
+        gauge("ber_rx_throughput_samples_per_second", "RX samples/s since start.", throughput_sps);
+        gauge("ber_bit_error_ratio", "Running bit error ratio.", ber);
+        gauge("ber_snr_db", "Running SNR estimate in dB.", snr_db);
+        summary("ber_buffer_push_latency_seconds", "iio_buffer_push call latency.", push_latency);
+        summary("ber_buffer_refill_latency_seconds", "iio_buffer_refill call latency.", refill_latency);
+        return out;
+    }
+};
+
+// Minimal single-threaded HTTP/1.0 server: every request gets the current
+// metrics page. Bound to loopback only.
+class MetricsServer {
+public:
+    ~MetricsServer() { stop(); }
+
+    bool start(int port, const Metrics& m) {
+        fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd_ < 0) return false;
+        int one = 1;
+        ::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+            ::listen(fd_, 4) < 0) {
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        running_ = true;
+        thread_ = std::thread([this, &m] { serve(m); });
+        return true;
+    }
+
+    void stop() {
+        running_ = false;
+        if (thread_.joinable()) thread_.join();
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+private:
+    void serve(const Metrics& m) {
+        while (running_) {
+            pollfd pfd{fd_, POLLIN, 0};
+            if (::poll(&pfd, 1, 200) <= 0) continue;
+            const int c = ::accept(fd_, nullptr, nullptr);
+            if (c < 0) continue;
+            // A client that sends nothing within the poll interval is
+            // dropped, so stop() never waits on it
+            pollfd cp{c, POLLIN, 0};
+            char req[1024];
+            if (::poll(&cp, 1, 200) <= 0 || ::recv(c, req, sizeof(req), 0) <= 0) {
+                ::close(c);
+                continue;
+            }
+            // The request line is ignored; a client that stops reading is
+            // given up on after the same interval
+            const timeval tv{0, 200000};
+            ::setsockopt(c, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+            const std::string body = m.render();
+            const std::string resp =
+                "HTTP/1.0 200 OK\r\n"
+                "Content-Type: text/plain; version=0.0.4\r\n"
+                "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                "Connection: close\r\n\r\n" + body;
+            size_t off = 0;
+            while (off < resp.size()) {
+                const ssize_t n = ::send(c, resp.data() + off, resp.size() - off, MSG_NOSIGNAL);
+                if (n <= 0) break;
+                off += static_cast<size_t>(n);
+            }
+            ::close(c);
+        }
+    }
+
+    int fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
@@ -0,0 +1,99 @@
+// Preallocated I/Q sample storage for the streaming threads. One arena is
+// mapped before streaming starts (optionally on 2 MiB hugepages) and handed
+// out block by block, so the hot loops never touch the heap. Blocks follow
+// each other in the arena: a captured stream is one contiguous I plane and
+// one contiguous Q plane. A pool is owned by a single thread while streaming.
+#pragma once
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+struct SampleBlock {
+    int16_t* i;
+    int16_t* q;
+    size_t   capacity;   // samples that fit; 0 = pool exhausted
+};
+
+class BlockPool {
+public:
+    BlockPool() = default;
+    ~BlockPool() { unmap(); }
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    // Room for `nblocks` blocks of `block_samples`. With `wrap`, acquire()
+    // starts over at the beginning instead of running out (only the current
+    // pass is kept). Reuses the existing mapping if it is large enough.
+    // Returns an empty string on success or what failed.
+    std::string init(size_t block_samples, size_t nblocks, bool wrap, bool hugepages) {
+        const size_t cap = round_up(block_samples * nblocks, SAMPLE_ALIGN);
+        block_ = block_samples;
+        wrap_ = wrap;
+        size_ = 0;
+        if (base_ && cap <= capacity_ && hugepages == want_huge_) return "";
+        unmap();
+        const size_t bytes = 2 * cap * sizeof(int16_t);
+        void* p = MAP_FAILED;
+        if (hugepages) {
+            bytes_ = round_up(bytes, HUGE_PAGE);
+            p = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+        huge_ = (p != MAP_FAILED);
+        if (!huge_) {
+            bytes_ = bytes;
+            p = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) {
+                bytes_ = 0;
+                return "sample pool mmap(" + std::to_string(bytes) + "): " + std::strerror(errno);
+            }
+        }
+        base_ = static_cast<int16_t*>(p);
+        capacity_ = cap;
+        want_huge_ = hugepages;
+        return "";
+    }
+
+    // Writes every page so the first pass through the pool can't fault.
+    void prefault() {
+        if (base_) std::memset(base_, 0, 2 * capacity_ * sizeof(int16_t));
+    }
+
+    // Next block to fill, starting right after the last commit().
+    SampleBlock acquire() {
+        if (wrap_ && size_ + block_ > capacity_) size_ = 0;
+        const size_t room = std::min(block_, capacity_ - size_);
+        return {base_ + size_, base_ + capacity_ + size_, room};
+    }
+
+    // Keeps the first n samples of the block from the last acquire().
+    void commit(size_t n) { size_ += n; }
+
+    const int16_t* i()            const { return base_; }
+    const int16_t* q()            const { return base_ + capacity_; }
+    size_t         size()         const { return size_; }
+    size_t         capacity()     const { return capacity_; }
+    bool           on_hugepages() const { return huge_; }
+
+private:
+    static constexpr size_t SAMPLE_ALIGN = 32;               // Q plane on a cache line
+    static constexpr size_t HUGE_PAGE    = 2u * 1024 * 1024;
+
+    static size_t round_up(size_t v, size_t a) { return (v + a - 1) / a * a; }
+
+    void unmap() {
+        if (base_) munmap(base_, bytes_);
+        base_ = nullptr;
+        capacity_ = bytes_ = size_ = 0;
+    }
+
+    int16_t* base_ = nullptr;
+    size_t   capacity_ = 0, bytes_ = 0, block_ = 0, size_ = 0;
+    bool     wrap_ = false, huge_ = false, want_huge_ = false;
+};
@@ -0,0 +1,189 @@
+// Streaming Welch power spectral density of the RX samples. Hann-windowed
+// segments of `nfft` samples with 50% overlap go through a radix-2 FFT and
+// their power is summed per bin, so memory stays at a few nfft-sized arrays
+// however long the run. Levels are in dB relative to ADC full scale: a
+// complex tone of amplitude 2048 reads 0 dBFS in power_db().
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// In-place radix-2 decimation-in-time FFT on split real/imaginary arrays.
+// The bit-reversal permutation and the twiddles are computed once, the
+// twiddles of each stage stored contiguously so the butterflies vectorize.
+class Fft {
+public:
+    explicit Fft(size_t n) : n_(n), rev_(n), cos_(n), sin_(n) {
+        unsigned bits = 0;
+        while ((size_t(1) << bits) < n) ++bits;
+        for (size_t k = 0; k < n; ++k) {
+            size_t r = 0;
+            for (unsigned b = 0; b < bits; ++b) r |= ((k >> b) & 1) << (bits - 1 - b);
+            rev_[k] = static_cast<uint32_t>(r);
+        }
+        // Stage with butterflies `half` apart uses cos_/sin_[half + k], k < half
+        for (size_t half = 1; half < n; half *= 2)
+            for (size_t k = 0; k < half; ++k) {
+                cos_[half + k] = static_cast<float>(std::cos(M_PI * k / half));
+                sin_[half + k] = static_cast<float>(-std::sin(M_PI * k / half));
+            }
+    }
+
+    size_t size() const { return n_; }
+
+    void forward(float* re, float* im) const {
+        for (size_t k = 0; k < n_; ++k)
+            if (rev_[k] > k) {
+                std::swap(re[k], re[rev_[k]]);
+                std::swap(im[k], im[rev_[k]]);
+            }
+        for (size_t half = 1; half < n_; half *= 2) {
+            const float* wr = cos_.data() + half;
+            const float* wi = sin_.data() + half;
+            for (size_t start = 0; start < n_; start += 2 * half) {
+                float* ar = re + start;        float* ai = im + start;
+                float* br = re + start + half; float* bi = im + start + half;
+                for (size_t k = 0; k < half; ++k) {
+                    const float tr = br[k] * wr[k] - bi[k] * wi[k];
+                    const float ti = br[k] * wi[k] + bi[k] * wr[k];
+                    br[k] = ar[k] - tr; bi[k] = ai[k] - ti;
+                    ar[k] += tr;        ai[k] += ti;
+                }
+            }
+        }
+    }
+
+private:
+    size_t                n_;
+    std::vector<uint32_t> rev_;
+    std::vector<float>    cos_, sin_;
+};
+
+class WelchPsd {
+public:
+    static constexpr double FULL_SCALE = 2048.0;
+
+    // nfft: power of two, at least 16.
+    explicit WelchPsd(size_t nfft = 1024)
+        : fft_(nfft), window_(nfft), seg_i_(nfft), seg_q_(nfft), re_(nfft), im_(nfft), acc_(nfft, 0.0) {
+        double sum = 0;
+        for (size_t k = 0; k < nfft; ++k) {
+            window_[k] = static_cast<float>(0.5 - 0.5 * std::cos(2 * M_PI * k / nfft));   // periodic Hann
+            sum += window_[k];
+            wsq_ += static_cast<double>(window_[k]) * window_[k];
+        }
+        wsum_ = sum;
+    }
+
+    size_t   nfft()   const { return fft_.size(); }
+    uint64_t frames() const { return frames_; }
+
+    // Adds samples; every completed segment is transformed right away.
+    void push(const int16_t* i, const int16_t* q, size_t n) {
+        const size_t N = nfft(), HOP = N / 2;
+        while (n > 0) {
+            const size_t k = std::min(n, N - fill_);
+            std::copy(i, i + k, seg_i_.begin() + fill_);
+            std::copy(q, q + k, seg_q_.begin() + fill_);
+            fill_ += k;
+            i += k; q += k; n -= k;
+            if (fill_ == N) {
+                segment();
+                // Keep the second half as the start of the next segment
+                std::copy(seg_i_.begin() + HOP, seg_i_.end(), seg_i_.begin());
+                std::copy(seg_q_.begin() + HOP, seg_q_.end(), seg_q_.begin());
+                fill_ = N - HOP;
+            }
+        }
+    }
+
+    // Drops a partial segment, e.g. after samples were lost.
+    void restart_segment() { fill_ = 0; }
+
+    // Power in FFT bin k (0 = DC, natural order), dBFS; a tone centred on
+    // a bin reads its level. -inf before the first segment.
+    double power_db(size_t k) const {
+        if (frames_ == 0) return -INFINITY;
+        const double p = acc_[k] / frames_ / (wsum_ * wsum_) / (FULL_SCALE * FULL_SCALE);
+        return 10 * std::log10(std::max(p, 1e-30));
+    }
+
+    // Power spectral density in bin k, dBFS/Hz at `sample_rate`.
+    double density_db(size_t k, double sample_rate) const {
+        if (frames_ == 0) return -INFINITY;
+        const double p = acc_[k] / frames_ / (wsq_ * sample_rate) / (FULL_SCALE * FULL_SCALE);
+        return 10 * std::log10(std::max(p, 1e-30));
+    }
+
+    // Frequency offset of bin k from the LO, Hz, in [-fs/2, fs/2).
+    double bin_hz(size_t k, double sample_rate) const {
+        const double N = static_cast<double>(nfft());
+        return (k < nfft() / 2 ? k : k - N) * sample_rate / N;
+    }
+
+    // Occupied bandwidth, Hz: the band left after trimming (1 - fraction)/2
+    // of the total power from each edge of the spectrum.
+    double occupied_bw(double sample_rate, double fraction = 0.99) const {
+        const size_t N = nfft();
+        double total = 0;
+        for (double v : acc_) total += v;
+        if (total <= 0) return 0;
+        const double tail = total * (1 - fraction) / 2;
+        // Walk from -fs/2 upwards (bins N/2 .. N-1, then 0 .. N/2-1)
+        auto at = [&](size_t j) { return acc_[(j + N / 2) % N]; };
+        size_t lo = 0, hi = N - 1;
+        for (double s = 0; lo < N && s + at(lo) <= tail; ++lo) s += at(lo);
+        for (double s = 0; hi > lo && s + at(hi) <= tail; --hi) s += at(hi);
+        return (hi - lo + 1) * sample_rate / N;
+    }
+
+    // Strongest bin other than DC.
+    size_t peak_bin() const {
+        size_t best = 1;
+        for (size_t k = 2; k < nfft(); ++k)
+            if (acc_[k] > acc_[best]) best = k;
+        return best;
+    }
+
+    // CSV of the spectrum from -fs/2 to fs/2: offset_hz,rf_hz,power_dbfs,psd_dbfs_hz.
+    bool write_csv(const std::string& path, double sample_rate, double center_hz) const {
+        std::FILE* f = std::fopen(path.c_str(), "w");
+        if (!f) return false;
+        std::fprintf(f, "offset_hz,rf_hz,power_dbfs,psd_dbfs_hz\n");
+        const size_t N = nfft();
+        for (size_t j = 0; j < N; ++j) {
+            const size_t k = (j + N / 2) % N;
+            const double off = bin_hz(k, sample_rate);
+            std::fprintf(f, "%.1f,%.1f,%.2f,%.2f\n", off, center_hz + off, power_db(k),
+                         density_db(k, sample_rate));
+        }
+        return std::fclose(f) == 0;
+    }
+
+private:
+    void segment() {
+        const size_t N = nfft();
+        for (size_t k = 0; k < N; ++k) {
+            re_[k] = seg_i_[k] * window_[k];
+            im_[k] = seg_q_[k] * window_[k];
+        }
+        fft_.forward(re_.data(), im_.data());
+        for (size_t k = 0; k < N; ++k)
+            acc_[k] += static_cast<double>(re_[k]) * re_[k] + static_cast<double>(im_[k]) * im_[k];
+        frames_++;
+    }
+
+    Fft                  fft_;
+    std::vector<float>   window_;
+    std::vector<int16_t> seg_i_, seg_q_;   // current segment, `fill_` samples
+    std::vector<float>   re_, im_;
+    std::vector<double>  acc_;             // summed |X[k]|^2
+    double               wsum_ = 0, wsq_ = 0;
+    size_t               fill_ = 0;
+    uint64_t             frames_ = 0;
+};
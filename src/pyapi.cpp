@@ -0,0 +1,192 @@
+// C ABI over the capture readers and the link analysis, loaded from Python
+// by berest.py through ctypes:
+//
+//   g++ pyapi.cpp -O2 -std=c++17 -shared -fPIC -o libberest.so
+//
+// Sample arrays cross the boundary as raw pointers: ci16 captures hand out
+// the address of their mapping, and the analysis reads NumPy buffers in
+// place, so nothing is copied on either side. Functions that can fail
+// return 0 / nullptr and leave the reason in berest_last_error().
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "analysis.hpp"
+#include "capture_reader.hpp"
+#include "stream.hpp"
+
+#define BEREST_API extern "C" __attribute__((visibility("default")))
+
+// Bumped when a signature or BerestLinkStats changes.
+constexpr int BEREST_ABI = 1;
+
+static thread_local std::string g_error;
+
+struct Capture {
+    MappedCapture raw;
+    PackedCapture packed;
+    bool          is_packed = false;
+    size_t size() const { return is_packed ? static_cast<size_t>(packed.samples()) : raw.size(); }
+};
+
+// LinkAnalyzer plus the TX reference generator, so a capture can be fed
+// RX-only like capture_tool analyze does.
+struct Link {
+    LinkAnalyzer                analyzer;
+    std::mt19937                rng{TX_SEED};
+    std::bernoulli_distribution bitdist{0.5};
+    std::vector<int16_t>        ref_i, ref_q;
+    int16_t                     amp;
+
+    Link(size_t window, size_t max_lag, double threshold, int16_t amp_)
+        : analyzer(window, max_lag, threshold), amp(amp_) {}
+
+    void push_reference(size_t n) {
+        if (ref_i.size() < n) { ref_i.resize(n); ref_q.resize(n); }
+        qpsk_reference(rng, bitdist, amp, ref_i.data(), ref_q.data(), n);
+        analyzer.push_tx(ref_i.data(), ref_q.data(), n);
+    }
+};
+
+// Mirrors LinkAnalyzer's results; NaN where undefined.
+struct BerestLinkStats {
+    int32_t  locked, failed;
+    uint64_t lag;
+    double   phase, dc_i, dc_q;
+    uint64_t clipped, skipped, symbols, bits, bit_errors, symbol_errors;
+    double   ber, ber_lo, ber_hi, ser, ser_lo, ser_hi;
+    double   snr_db, evm_rms, signal_power, noise_power;
+};
+
+BEREST_API int berest_abi_version() { return BEREST_ABI; }
+
+BEREST_API const char* berest_last_error() { return g_error.c_str(); }
+
+// ---------- Captures ----------
+// A .bcap path opens as a packed capture, anything else as ci16_le.
+BEREST_API Capture* berest_capture_open(const char* path) {
+    Capture* c = new Capture;
+    const size_t len = std::strlen(path);
+    c->is_packed = len >= 5 && std::strcmp(path + len - 5, ".bcap") == 0;
+    g_error = c->is_packed ? c->packed.open(path) : c->raw.open(path);
+    if (!g_error.empty()) {
+        delete c;
+        return nullptr;
+    }
+    return c;
+}
+
+BEREST_API void berest_capture_close(Capture* c) { delete c; }
+
+BEREST_API uint64_t berest_capture_samples(const Capture* c) { return c->size(); }
+BEREST_API int      berest_capture_packed(const Capture* c) { return c->is_packed; }
+BEREST_API double   berest_capture_sample_rate(const Capture* c) {
+    return c->is_packed ? c->packed.sample_rate() : 0.0;
+}
+
+// Interleaved samples of a ci16 capture, valid until it is closed; nullptr
+// for packed captures (use berest_capture_read) and empty files.
+BEREST_API const int16_t* berest_capture_data(const Capture* c) {
+    return c->is_packed ? nullptr : c->raw.span(0, c->raw.size()).iq;
+}
+
+// Copies samples [first, first + n), clipped to the capture, into i/q and
+// returns how many. Packed captures decode only the blocks involved.
+// Returns -1 on a corrupt block.
+BEREST_API int64_t berest_capture_read(const Capture* c, uint64_t first, uint64_t n,
+                                       int16_t* i, int16_t* q) {
+    if (first >= c->size()) return 0;
+    n = std::min<uint64_t>(n, c->size() - first);
+    if (!c->is_packed) {
+        const IqSpan s = c->raw.span(static_cast<size_t>(first), static_cast<size_t>(n));
+        for (size_t k = 0; k < s.n; ++k) { i[k] = s.i(k); q[k] = s.q(k); }
+        return static_cast<int64_t>(s.n);
+    }
+    const PackedCapture& p = c->packed;
+    std::vector<int16_t> bi(p.block_samples()), bq(p.block_samples());
+    for (size_t b = p.block_of_sample(first); b < p.blocks() && p.entry(b).first_sample < first + n; ++b) {
+        size_t got = 0;
+        if (!p.decode(b, bi.data(), bq.data(), got)) {
+            g_error = "corrupt block " + std::to_string(b);
+            return -1;
+        }
+        const uint64_t s0 = p.entry(b).first_sample;
+        const uint64_t lo = std::max(first, s0), hi = std::min(first + n, s0 + got);
+        std::copy(bi.begin() + (lo - s0), bi.begin() + (hi - s0), i + (lo - first));
+        std::copy(bq.begin() + (lo - s0), bq.begin() + (hi - s0), q + (lo - first));
+    }
+    return static_cast<int64_t>(n);
+}
+
+// ---------- Link analysis ----------
+BEREST_API Link* berest_link_new(uint64_t window, uint64_t max_lag, double threshold, int16_t amp) {
+    return new Link(static_cast<size_t>(window), static_cast<size_t>(max_lag), threshold, amp);
+}
+
+BEREST_API void berest_link_free(Link* l) { delete l; }
+
+BEREST_API void berest_link_set_lag_hint(Link* l, uint64_t lag, uint64_t tolerance) {
+    l->analyzer.set_lag_hint(static_cast<size_t>(lag), static_cast<size_t>(tolerance));
+}
+
+BEREST_API void berest_link_push_tx(Link* l, const int16_t* i, const int16_t* q, uint64_t n) {
+    l->analyzer.push_tx(i, q, static_cast<size_t>(n));
+}
+
+BEREST_API void berest_link_push_rx(Link* l, const int16_t* i, const int16_t* q, uint64_t n) {
+    l->analyzer.push_rx(i, q, static_cast<size_t>(n));
+}
+
+// RX only: the matching TX symbols are regenerated from the seed.
+BEREST_API void berest_link_push_rx_seeded(Link* l, const int16_t* iq, uint64_t n) {
+    l->push_reference(static_cast<size_t>(n));
+    l->analyzer.push_rx_interleaved(iq, static_cast<size_t>(n));
+}
+
+BEREST_API void berest_link_finish(Link* l) { l->analyzer.finish(); }
+
+BEREST_API void berest_link_stats(const Link* l, BerestLinkStats* out) {
+    const LinkAnalyzer& a = l->analyzer;
+    BerestLinkStats s{};
+    s.locked = a.locked();
+    s.failed = a.failed();
+    s.lag = a.lag();
+    s.phase = a.phase(); s.dc_i = a.dc_i(); s.dc_q = a.dc_q();
+    s.clipped = a.clipped(); s.skipped = a.skipped();
+    s.symbols = a.symbols(); s.bits = a.bits();
+    s.bit_errors = a.bit_errors(); s.symbol_errors = a.symbol_errors();
+    s.ber = a.ber(); s.ser = a.ser();
+    wilson_interval(a.bit_errors(), a.bits(), 1.96, s.ber_lo, s.ber_hi);
+    wilson_interval(a.symbol_errors(), a.symbols(), 1.96, s.ser_lo, s.ser_hi);
+    s.snr_db = a.snr_db(); s.evm_rms = a.evm_rms();
+    s.signal_power = a.signal_power(); s.noise_power = a.noise_power();
+    *out = s;
+}
+
+// Whole-capture analysis in one call, block by block as capture_tool
+// analyze does: ci16 captures stream through the mapping, packed ones
+// decode a block at a time. Returns 0 on a corrupt block.
+BEREST_API int berest_link_push_capture(Link* l, const Capture* c, uint64_t block) {
+    if (block == 0) block = 1u << 16;
+    if (!c->is_packed) {
+        c->raw.for_each_block(static_cast<size_t>(block), [&](const IqSpan& s) {
+            berest_link_push_rx_seeded(l, s.iq, s.n);
+        });
+        return 1;
+    }
+    const PackedCapture& p = c->packed;
+    std::vector<int16_t> i(p.block_samples()), q(p.block_samples());
+    for (size_t b = 0; b < p.blocks(); ++b) {
+        size_t n = 0;
+        if (!p.decode(b, i.data(), q.data(), n)) {
+            g_error = "corrupt block " + std::to_string(b);
+            return 0;
+        }
+        l->push_reference(n);
+        l->analyzer.push_rx(i.data(), q.data(), n);
+    }
+    return 1;
+}
@@ -0,0 +1,44 @@
+// Real-time helpers for the streaming threads: SCHED_FIFO priority, CPU
+// pinning, mlockall and stack prefaulting. Linux only. Each returns an
+// empty string on success or a description of what failed.
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+// priority: SCHED_FIFO priority 1..99, 0 keeps the default policy.
+// cpu:      core to pin the calling thread to, -1 leaves affinity alone.
+inline std::string set_thread_realtime(int priority, int cpu) {
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        const int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (ret != 0) return "pin to CPU " + std::to_string(cpu) + ": " + std::strerror(ret);
+    }
+    if (priority > 0) {
+        sched_param sp{};
+        sp.sched_priority = priority;
+        const int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+        if (ret != 0) return "SCHED_FIFO priority " + std::to_string(priority) + ": " +
+                             std::strerror(ret);
+    }
+    return "";
+}
+
+// Locks current and future mappings (heap, stacks, libiio buffers) in RAM.
+inline std::string lock_memory() {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) return std::string("mlockall: ") + std::strerror(errno);
+    return "";
+}
+
+// Touches `bytes` of the calling thread's stack so later growth can't fault.
+inline void prefault_stack(size_t bytes = 256 * 1024) {
+    volatile unsigned char* p = static_cast<volatile unsigned char*>(__builtin_alloca(bytes));
+    for (size_t k = 0; k < bytes; k += 4096) p[k] = 0;
+}
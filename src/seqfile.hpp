@@ -0,0 +1,89 @@
+// Append-only output file for recordings. Bytes are staged in one buffer
+// allocated at open() and handed to the kernel in whole chunks, so a
+// recording is a series of large sequential write(2) calls.
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+class SeqFile {
+public:
+    ~SeqFile() { close(); }
+
+    // Returns an empty string on success or what failed.
+    std::string open(const std::string& path, size_t chunk_bytes = 4u << 20) {
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) return path + ": " + std::strerror(errno);
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+        stage_.assign(chunk_bytes, 0);
+        used_ = 0;
+        written_ = 0;
+        error_.clear();
+        return "";
+    }
+
+    // Space for up to `n` bytes at the end of the staging buffer, flushing
+    // first if needed; n must not exceed the chunk size. Follow with commit().
+    uint8_t* reserve(size_t n) {
+        if (used_ + n > stage_.size()) flush();
+        return stage_.data() + used_;
+    }
+    void commit(size_t n) {
+        used_ += n;
+        written_ += n;
+        if (used_ == stage_.size()) flush();
+    }
+
+    void append(const void* data, size_t n) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        while (n > 0) {
+            const size_t k = std::min(n, stage_.size() - used_);
+            std::memcpy(stage_.data() + used_, p, k);
+            commit(k);
+            p += k;
+            n -= k;
+        }
+    }
+
+    // Writes what is staged and closes the file. Returns the first error.
+    std::string close() {
+        if (fd_ < 0) return error_;
+        flush();
+        if (::close(fd_) != 0 && error_.empty()) error_ = std::strerror(errno);
+        fd_ = -1;
+        return error_;
+    }
+
+    size_t   chunk_bytes() const { return stage_.size(); }
+    uint64_t offset()      const { return written_; }   // bytes appended so far
+
+private:
+    void flush() {
+        const uint8_t* p = stage_.data();
+        size_t left = used_;
+        while (left > 0 && error_.empty()) {
+            const ssize_t w = ::write(fd_, p, left);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                error_ = std::strerror(errno);
+                break;
+            }
+            p += w;
+            left -= static_cast<size_t>(w);
+        }
+        used_ = 0;
+    }
+
+    int                  fd_ = -1;
+    std::vector<uint8_t> stage_;
+    size_t               used_ = 0;
+    uint64_t             written_ = 0;
+    std::string          error_;
+};
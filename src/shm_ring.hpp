@@ -0,0 +1,275 @@
+// Live RX samples in POSIX shared memory, for local consumers such as a
+// viewer or a second analyzer. One writer, any number of readers, and the
+// writer never waits: readers that fall more than a ring behind lose
+// samples rather than holding up the radio.
+//
+// Segment layout (/dev/shm/NAME):
+//   [0, 4096)  ShmRingHeader
+//   [4096, ..) `capacity` interleaved ci16 samples; stream sample s is at
+//              slot s % capacity
+//
+// Sequence protocol: before overwriting slots the writer raises `claimed`
+// to the end of the block, and after writing it raises `published`.
+// Samples [published - capacity, published) are readable in place. A reader
+// that accessed samples from `first` on checks afterwards that
+// claimed - capacity <= first; otherwise some of them were overwritten
+// while it read (a seqlock over the whole ring).
+#pragma once
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include "capture_reader.hpp"
+
+constexpr uint32_t SHM_RING_MAGIC   = 0x474e5242;   // "BRNG"
+constexpr uint32_t SHM_RING_VERSION = 1;
+constexpr size_t   SHM_RING_DATA    = 4096;         // byte offset of the samples
+
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;          // samples, a power of two
+    double   sample_rate;       // Hz
+    double   center_hz;         // RX LO
+    int64_t  start_unix_ns;     // wall clock at sample 0
+    uint32_t writer_pid;
+    uint32_t reserved;
+    alignas(64) std::atomic<uint64_t> claimed;     // slots below this may be being written
+    alignas(64) std::atomic<uint64_t> published;   // samples [0, published) were written
+    std::atomic<uint32_t> closed;                  // writer finished; published is final
+};
+static_assert(sizeof(ShmRingHeader) <= SHM_RING_DATA, "ring header overlaps the samples");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring counters must be lock-free across processes");
+
+// Writer side, owned by the RX thread. publish() only copies and never
+// allocates or blocks.
+class ShmRingWriter {
+public:
+    ShmRingWriter() = default;
+    ~ShmRingWriter() { close(); }
+    ShmRingWriter(const ShmRingWriter&) = delete;
+    ShmRingWriter& operator=(const ShmRingWriter&) = delete;
+
+    // Creates /NAME with room for at least `min_capacity` samples. A segment
+    // of that name left by a writer that died is replaced; one whose writer
+    // is still running, or that is not a ring, is left alone and the call
+    // fails. Returns an empty string on success or what failed.
+    std::string create(const std::string& name, size_t min_capacity, double sample_rate, double center_hz) {
+        close();
+        size_t cap = 1;
+        while (cap < min_capacity) cap <<= 1;
+        name_ = name[0] == '/' ? name : "/" + name;
+        int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0 && errno == EEXIST) {
+            const std::string busy = in_use(name_);
+            if (!busy.empty()) return busy;
+            shm_unlink(name_.c_str());
+            fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        }
+        if (fd < 0) return "shm_open " + name_ + ": " + std::strerror(errno);
+        bytes_ = SHM_RING_DATA + cap * 2 * sizeof(int16_t);
+        if (ftruncate(fd, static_cast<off_t>(bytes_)) != 0) {
+            const std::string err = "ftruncate " + name_ + ": " + std::strerror(errno);
+            ::close(fd);
+            shm_unlink(name_.c_str());
+            return err;
+        }
+        void* p = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            shm_unlink(name_.c_str());
+            return "mmap " + name_ + ": " + std::strerror(errno);
+        }
+        // Touch every page now so publish() never faults in fresh memory
+        std::memset(p, 0, bytes_);
+        hdr_ = new (p) ShmRingHeader{};
+        data_ = reinterpret_cast<int16_t*>(static_cast<uint8_t*>(p) + SHM_RING_DATA);
+        mask_ = cap - 1;
+        hdr_->capacity = cap;
+        hdr_->sample_rate = sample_rate;
+        hdr_->center_hz = center_hz;
+        hdr_->writer_pid = static_cast<uint32_t>(getpid());
+        hdr_->version = SHM_RING_VERSION;
+        std::atomic_thread_fence(std::memory_order_release);
+        hdr_->magic = SHM_RING_MAGIC;
+        return "";
+    }
+
+    bool   is_open()  const { return hdr_ != nullptr; }
+    size_t capacity() const { return mask_ + 1; }
+
+    // Wall-clock time of sample 0, for readers converting sequence numbers.
+    void set_start_time(int64_t unix_ns) { if (hdr_) hdr_->start_unix_ns = unix_ns; }
+
+    void publish(const int16_t* i, const int16_t* q, size_t n) {
+        // A block larger than the ring only leaves its tail readable
+        if (n > capacity()) {
+            skip(n - capacity());
+            i += n - capacity(); q += n - capacity();
+            n = capacity();
+        }
+        const uint64_t seq = hdr_->published.load(std::memory_order_relaxed);
+        hdr_->claimed.store(seq + n, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t k = 0; k < n; ++k) {
+            int16_t* s = data_ + 2 * ((seq + k) & mask_);
+            s[0] = i[k];
+            s[1] = q[k];
+        }
+        hdr_->published.store(seq + n, std::memory_order_release);
+    }
+
+    // Marks the stream finished and removes the name; attached readers keep
+    // their mapping and can drain what is left.
+    void close() {
+        if (!hdr_) return;
+        hdr_->closed.store(1, std::memory_order_release);
+        munmap(hdr_, bytes_);
+        shm_unlink(name_.c_str());
+        hdr_ = nullptr;
+        data_ = nullptr;
+    }
+
+private:
+    // Why the existing segment `name` must not be replaced, or "" if it is
+    // a ring whose writer has exited.
+    static std::string in_use(const std::string& name) {
+        const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return "";   // removed meanwhile
+        struct stat sb{};
+        void* p = MAP_FAILED;
+        if (fstat(fd, &sb) == 0 && static_cast<size_t>(sb.st_size) >= sizeof(ShmRingHeader))
+            p = mmap(nullptr, sizeof(ShmRingHeader), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return name + " exists and is not a sample ring";
+        const ShmRingHeader* h = static_cast<const ShmRingHeader*>(p);
+        std::string err;
+        if (h->magic != SHM_RING_MAGIC) {
+            err = name + " exists and is not a sample ring";
+        } else if (!h->closed.load(std::memory_order_acquire)) {
+            const pid_t pid = static_cast<pid_t>(h->writer_pid);
+            if (pid > 0 && (kill(pid, 0) == 0 || errno == EPERM))
+                err = name + " is in use by process " + std::to_string(pid);
+        }
+        munmap(p, sizeof(ShmRingHeader));
+        return err;
+    }
+
+    void skip(size_t n) {
+        const uint64_t seq = hdr_->published.load(std::memory_order_relaxed) + n;
+        hdr_->claimed.store(seq, std::memory_order_relaxed);
+        hdr_->published.store(seq, std::memory_order_release);
+    }
+
+    std::string    name_;
+    ShmRingHeader* hdr_ = nullptr;
+    int16_t*       data_ = nullptr;
+    size_t         bytes_ = 0;
+    size_t         mask_ = 0;
+};
+
+// Reader side. Attaching never disturbs the writer or other readers; each
+// reader keeps its own position.
+class ShmRingReader {
+public:
+    ShmRingReader() = default;
+    ~ShmRingReader() { close(); }
+    ShmRingReader(const ShmRingReader&) = delete;
+    ShmRingReader& operator=(const ShmRingReader&) = delete;
+
+    // Returns an empty string on success or what failed.
+    std::string open(const std::string& name) {
+        close();
+        const std::string path = name[0] == '/' ? name : "/" + name;
+        const int fd = shm_open(path.c_str(), O_RDONLY, 0);
+        if (fd < 0) return "shm_open " + path + ": " + std::strerror(errno);
+        struct stat sb{};
+        if (fstat(fd, &sb) != 0 || sb.st_size < static_cast<off_t>(SHM_RING_DATA)) {
+            ::close(fd);
+            return path + " is not a sample ring";
+        }
+        bytes_ = static_cast<size_t>(sb.st_size);
+        void* p = mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return "mmap " + path + ": " + std::strerror(errno);
+        hdr_ = static_cast<const ShmRingHeader*>(p);
+        if (hdr_->magic != SHM_RING_MAGIC || hdr_->version != SHM_RING_VERSION ||
+            SHM_RING_DATA + hdr_->capacity * 2 * sizeof(int16_t) != bytes_) {
+            close();
+            return path + " is not a sample ring";
+        }
+        data_ = reinterpret_cast<const int16_t*>(static_cast<const uint8_t*>(p) + SHM_RING_DATA);
+        mask_ = hdr_->capacity - 1;
+        next_ = published();
+        return "";
+    }
+
+    void close() {
+        if (hdr_) munmap(const_cast<ShmRingHeader*>(hdr_), bytes_);
+        hdr_ = nullptr;
+        data_ = nullptr;
+    }
+
+    const ShmRingHeader& header() const { return *hdr_; }
+    size_t   capacity()  const { return mask_ + 1; }
+    uint64_t published() const { return hdr_->published.load(std::memory_order_acquire); }
+    bool     closed()    const { return hdr_->closed.load(std::memory_order_acquire) != 0; }
+    uint64_t next()      const { return next_; }   // first sample the next read() delivers
+    uint64_t lost()      const { return lost_; }   // samples overwritten before this reader got them
+
+    // Start from the oldest sample still in the ring rather than the newest.
+    void rewind() {
+        const uint64_t head = published();
+        next_ = head > capacity() ? head - capacity() : 0;
+    }
+
+    // Calls fn(IqSpan span, uint64_t first_sample) on the samples published
+    // since the last call, in at most two spans that point into the ring.
+    // Returns how many samples were delivered. Samples the writer had
+    // already lapped, or overwrote while fn was reading them, are counted
+    // in lost(); fn's results for an overwritten span should be discarded,
+    // which the return value of 0 signals.
+    template <class Fn> size_t read(Fn fn, size_t max_samples = SIZE_MAX) {
+        const uint64_t head = published();
+        if (head - next_ > capacity()) {
+            lost_ += head - capacity() - next_;
+            next_ = head - capacity();
+        }
+        const uint64_t end = next_ + std::min<uint64_t>(head - next_, max_samples);
+        const uint64_t first = next_;
+        for (uint64_t pos = first; pos < end;) {
+            const size_t off = static_cast<size_t>(pos & mask_);
+            const size_t n = static_cast<size_t>(std::min<uint64_t>(end - pos, capacity() - off));
+            fn(IqSpan{data_ + 2 * off, n}, pos);
+            pos += n;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t claimed = hdr_->claimed.load(std::memory_order_relaxed);
+        next_ = end;
+        if (claimed > capacity() && claimed - capacity() > first) {
+            lost_ += std::min(end, claimed - capacity()) - first;
+            return 0;
+        }
+        return static_cast<size_t>(end - first);
+    }
+
+private:
+    const ShmRingHeader* hdr_ = nullptr;
+    const int16_t*       data_ = nullptr;
+    size_t               bytes_ = 0;
+    size_t               mask_ = 0;
+    uint64_t             next_ = 0;
+    uint64_t             lost_ = 0;
+};
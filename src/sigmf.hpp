@@ -0,0 +1,134 @@
+// SigMF recordings: interleaved ci16_le samples in <base>.sigmf-data and a
+// JSON <base>.sigmf-meta. Sample data goes out through SeqFile in large
+// sequential writes.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+#include "seqfile.hpp"
+#include "stream.hpp"
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "ci16_le output assumes a little-endian host");
+
+class SigmfDataWriter : public SampleSink {
+public:
+    std::string open(const std::string& path) {
+        samples_ = 0;
+        return file_.open(path);
+    }
+
+    // Interleaves straight into the staging buffer of the file.
+    void write(const int16_t* i, const int16_t* q, size_t n) override {
+        samples_ += n;
+        const size_t per_chunk = file_.chunk_bytes() / (2 * sizeof(int16_t));
+        while (n > 0) {
+            const size_t k = std::min(n, per_chunk);
+            int16_t* out = reinterpret_cast<int16_t*>(file_.reserve(k * 2 * sizeof(int16_t)));
+            for (size_t s = 0; s < k; ++s) {
+                out[2 * s]     = i[s];
+                out[2 * s + 1] = q[s];
+            }
+            file_.commit(k * 2 * sizeof(int16_t));
+            i += k; q += k; n -= k;
+        }
+    }
+
+    // Writes what is staged and closes the file. Returns the first error.
+    std::string close() { return file_.close(); }
+
+    uint64_t samples() const { return samples_; }
+
+private:
+    SeqFile  file_;
+    uint64_t samples_ = 0;
+};
+
+// ---------- Metadata ----------
+struct SigmfAnnotation {
+    uint64_t    sample_start = 0;
+    uint64_t    sample_count = 0;
+    std::string label;
+    std::string comment;
+};
+
+struct SigmfMeta {
+    double      sample_rate = 0;
+    double      frequency = 0;          // RX LO, Hz
+    std::string datetime;               // capture start, ISO 8601 UTC
+    std::string description;
+    std::string hw;
+    std::string author;
+    std::string dataset;                // non-conforming data file ("" = <base>.sigmf-data)
+    std::string encoding;               // how `dataset` is encoded
+    // Values under the "pluto:" extension namespace
+    double      rf_bandwidth = 0;
+    double      tx_frequency = 0;
+    std::string rx_gain_mode;
+    double      rx_gain_db = 0;         // NaN = unknown
+    double      tx_gain_db = 0;
+    uint64_t    tx_seed = 0;            // mt19937 seed of the QPSK reference
+    int         tx_amplitude = 0;
+    std::vector<SigmfAnnotation> annotations;
+};
+
+inline bool write_sigmf_meta(const std::string& path, const SigmfMeta& m) {
+    std::ofstream ofs(path);
+    if (!ofs) return false;
+    JsonWriter j(ofs);
+    j.begin_object();
+    j.begin_object("global");
+    j.field("core:datatype", "ci16_le");
+    j.field("core:version", "1.0.0");
+    j.field("core:sample_rate", m.sample_rate);
+    j.field("core:num_channels", 1);
+    j.field("core:description", m.description);
+    j.field("core:hw", m.hw);
+    if (!m.author.empty()) j.field("core:author", m.author);
+    j.field("core:recorder", "ber-estimator");
+    if (!m.dataset.empty()) j.field("core:dataset", m.dataset);
+    j.begin_array("core:extensions");
+    j.begin_object();
+    j.field("name", "pluto");
+    j.field("version", "1.0.0");
+    j.field("optional", true);
+    j.end_object();
+    j.end_array();
+    j.field("pluto:rf_bandwidth", m.rf_bandwidth);
+    j.field("pluto:tx_frequency", m.tx_frequency);
+    j.field("pluto:rx_gain_control_mode", m.rx_gain_mode);
+    j.field("pluto:rx_gain_db", m.rx_gain_db);
+    j.field("pluto:tx_gain_db", m.tx_gain_db);
+    j.field("pluto:adc_bits", 12);
+    if (!m.encoding.empty()) j.field("pluto:encoding", m.encoding);
+    j.field("pluto:tx_prng", "mt19937");
+    j.field("pluto:tx_seed", m.tx_seed);
+    j.field("pluto:tx_amplitude", m.tx_amplitude);
+    j.end_object();
+
+    j.begin_array("captures");
+    j.begin_object();
+    j.field("core:sample_start", 0);
+    j.field("core:frequency", m.frequency);
+    if (!m.datetime.empty()) j.field("core:datetime", m.datetime);
+    j.end_object();
+    j.end_array();
+
+    j.begin_array("annotations");
+    for (const SigmfAnnotation& a : m.annotations) {
+        j.begin_object();
+        j.field("core:sample_start", a.sample_start);
+        j.field("core:sample_count", a.sample_count);
+        if (!a.label.empty())   j.field("core:label", a.label);
+        if (!a.comment.empty()) j.field("core:comment", a.comment);
+        j.end_object();
+    }
+    j.end_array();
+    j.end_object();
+    j.finish();
+    return static_cast<bool>(ofs);
+}
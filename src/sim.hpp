@@ -0,0 +1,78 @@
+// Simulated TX->RX loopback, standing in for the Pluto where the tools
+// around the radio (the daemon, a test executive driving it) are tested
+// without hardware. TX draws the same QPSK symbols as the streaming path
+// (mt19937 seeded TX_SEED, restarted every run); RX sees them delayed,
+// scaled, rotated and offset, with white Gaussian noise, rounded and
+// clipped to the 12-bit ADC range. Gains and LOs are not modelled.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "analysis.hpp"
+#include "stream.hpp"
+
+struct SimChannel {
+    size_t   lag = 1000;            // TX->RX delay, samples
+    double   gain = 0.8;            // RX amplitude relative to TX
+    double   phase = 0.5;           // carrier phase, rad
+    double   dc_i = 4, dc_q = -3;   // RX DC offset, ADC counts
+    double   snr_db = 20;           // at the RX, per sample
+    uint32_t noise_seed = 1;
+};
+
+class SimLoopback {
+public:
+    explicit SimLoopback(const SimChannel& ch = SimChannel()) : ch_(ch), noise_rng_(ch.noise_seed) {}
+
+    const SimChannel& channel() const { return ch_; }
+
+    // Runs n samples of amplitude `amp` through the channel in blocks of
+    // `block`, feeding the TX reference and the RX samples to `link` as the
+    // streaming path does, then finishes the analysis.
+    void stream(size_t n, size_t block, int16_t amp, LinkAnalyzer& link) {
+        std::mt19937 rng(TX_SEED);
+        std::bernoulli_distribution bitdist(0.5);
+        const double noise = amp * ch_.gain * std::pow(10.0, -ch_.snr_db / 20);   // per component
+        std::normal_distribution<double> awgn(0.0, noise);
+        const double c = ch_.gain * std::cos(ch_.phase), s = ch_.gain * std::sin(ch_.phase);
+
+        // tx_ holds the last `lag` TX samples followed by the current block
+        const size_t lag = ch_.lag;
+        tx_i_.assign(lag + block, 0);
+        tx_q_.assign(lag + block, 0);
+        rx_i_.resize(block);
+        rx_q_.resize(block);
+        for (size_t done = 0; done < n;) {
+            const size_t k = std::min(block, n - done);
+            int16_t* ti = tx_i_.data() + lag;
+            int16_t* tq = tx_q_.data() + lag;
+            qpsk_reference(rng, bitdist, amp, ti, tq, k);
+            link.push_tx(ti, tq, k);
+            for (size_t j = 0; j < k; ++j) {
+                const double i = tx_i_[j], q = tx_q_[j];
+                rx_i_[j] = adc(c * i - s * q + ch_.dc_i + awgn(noise_rng_));
+                rx_q_[j] = adc(s * i + c * q + ch_.dc_q + awgn(noise_rng_));
+            }
+            link.push_rx(rx_i_.data(), rx_q_.data(), k);
+            // Keep the newest `lag` TX samples as the head of the next block
+            std::copy(tx_i_.begin() + k, tx_i_.begin() + k + lag, tx_i_.begin());
+            std::copy(tx_q_.begin() + k, tx_q_.begin() + k + lag, tx_q_.begin());
+            done += k;
+        }
+        link.finish();
+    }
+
+private:
+    static int16_t adc(double v) {
+        return static_cast<int16_t>(std::clamp(std::lround(v), long(ADC_MIN), long(ADC_MAX)));
+    }
+
+    SimChannel           ch_;
+    std::mt19937         noise_rng_;
+    std::vector<int16_t> tx_i_, tx_q_, rx_i_, rx_q_;
+};
@@ -0,0 +1,277 @@
+// Hot loops of the TX/RX streaming path, shared by main.cpp and bench.cpp.
+// Kept free of libiio so they can be exercised on synthetic buffers.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Seed of the mt19937 that draws the TX bits; offline tools regenerate the
+// reference from it.
+constexpr uint32_t TX_SEED = 42;
+
+// ---------- TX: fill one interleaved buffer with random QPSK (I,Q = ±amp) ----------
+// Walks [p, end) with stride `inc` bytes, writes at most `max_samples` and
+// records every symbol in ref_i/ref_q (room for max_samples). Returns the
+// number of samples written.
+inline size_t fill_tx_block(uint8_t* p, const void* end, ptrdiff_t inc, size_t max_samples,
+                            std::mt19937& rng, std::bernoulli_distribution& bitdist, int16_t amp,
+                            int16_t* ref_i, int16_t* ref_q) {
+    size_t n = 0;
+    for (; p < end && n < max_samples; p += inc) {
+        int16_t* s = reinterpret_cast<int16_t*>(p);
+        const int bit_I = bitdist(rng) ? 1 : 0;
+        const int bit_Q = bitdist(rng) ? 1 : 0;
+        const int16_t i_val = bit_I ? amp : -amp;
+        const int16_t q_val = bit_Q ? amp : -amp;
+        s[0] = i_val; // I
+        s[1] = q_val; // Q
+        ref_i[n] = i_val;
+        ref_q[n] = q_val;
+        n++;
+    }
+    return n;
+}
+
+// ---------- TX reference: the same symbols fill_tx_block draws ----------
+// For offline analysis: regenerates the QPSK sequence from the RNG state
+// (mt19937 seeded TX_SEED in the streaming path) without a TX buffer.
+inline void qpsk_reference(std::mt19937& rng, std::bernoulli_distribution& bitdist, int16_t amp,
+                           int16_t* ref_i, int16_t* ref_q, size_t n) {
+    for (size_t k = 0; k < n; ++k) {
+        ref_i[k] = bitdist(rng) ? amp : -amp;
+        ref_q[k] = bitdist(rng) ? amp : -amp;
+    }
+}
+
+// ---------- RX: de-interleave one buffer into separate I and Q arrays ----------
+inline size_t copy_rx_block(const uint8_t* p, const void* end, ptrdiff_t inc, size_t max_samples,
+                            int16_t* out_i, int16_t* out_q) {
+    size_t n = 0;
+    for (; p < end && n < max_samples; p += inc) {
+        const int16_t* s = reinterpret_cast<const int16_t*>(p);
+        out_i[n] = s[0];
+        out_q[n] = s[1];
+        n++;
+    }
+    return n;
+}
+
+// ---------- CSV (raw only): n,tx_i,tx_q,rx_i,rx_q ----------
+namespace csv_detail {
+
+constexpr size_t CHUNK_ROWS = 1u << 15;
+constexpr size_t MAX_ROW    = 20 + 4 * 7 + 1;   // n, four ",-32768", '\n', room for the fixed-size copies
+
+struct Columns {
+    const int16_t *tx_i, *tx_q;
+    size_t         tx_n;
+    const int16_t *rx_i, *rx_q;
+    size_t         rx_n;
+};
+
+// ",<v>" for every 12-bit ADC value, padded to 8 bytes so that a field is
+// one fixed-size copy. Samples outside the ADC range go through to_chars.
+struct Field {
+    char    s[7];
+    uint8_t len;
+};
+
+inline const Field* field_table() {
+    static const std::vector<Field> table = [] {
+        std::vector<Field> t(4096);
+        for (int v = -2048; v < 2048; ++v) {
+            Field& f = t[static_cast<size_t>(v + 2048)];
+            f.s[0] = ',';
+            f.len = static_cast<uint8_t>(std::to_chars(f.s + 1, f.s + 7, v).ptr - f.s);
+        }
+        return t;
+    }();
+    return table.data() + 2048;
+}
+
+// Writes ",v"; needs 8 bytes of room.
+inline char* put(char* p, int v, const Field* table) {
+    if (v >= -2048 && v < 2048) {
+        std::memcpy(p, &table[v], sizeof(Field));
+        return p + table[v].len;
+    }
+    *p++ = ',';
+    return std::to_chars(p, p + 6, v).ptr;
+}
+
+// Decimal row numbers. The digits above the last two change once every 100
+// rows, so only they are converted; the last two come from a table.
+class RowNumber {
+public:
+    explicit RowNumber(size_t n) : hi_(n / 100), lo_(static_cast<unsigned>(n % 100)) { convert_hi(); }
+    // Writes the number; needs 26 bytes of room.
+    char* put(char* p) const {
+        static const char PAIRS[] =
+            "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+            "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+        if (hi_ == 0) return std::to_chars(p, p + 2, lo_).ptr;
+        std::memcpy(p, hi_digits_, sizeof(hi_digits_));
+        p += hi_len_;
+        std::memcpy(p, PAIRS + 2 * lo_, 2);
+        return p + 2;
+    }
+    void next() {
+        if (++lo_ < 100) return;
+        lo_ = 0;
+        ++hi_;
+        convert_hi();
+    }
+private:
+    void convert_hi() { hi_len_ = static_cast<size_t>(std::to_chars(hi_digits_, hi_digits_ + 20, hi_).ptr - hi_digits_); }
+
+    size_t   hi_;
+    unsigned lo_;
+    char     hi_digits_[24] = {};
+    size_t   hi_len_ = 0;
+};
+
+// Formats rows [first, last) into p (room for MAX_ROW per row); returns the end.
+inline char* format_rows(char* p, const Columns& c, size_t first, size_t last) {
+    const Field* table = field_table();
+    RowNumber row(first);
+    for (size_t n = first; n < last; ++n, row.next()) {
+        p = row.put(p);
+        p = put(p, n < c.tx_n ? c.tx_i[n] : 0, table);
+        p = put(p, n < c.tx_n ? c.tx_q[n] : 0, table);
+        p = put(p, n < c.rx_n ? c.rx_i[n] : 0, table);
+        p = put(p, n < c.rx_n ? c.rx_q[n] : 0, table);
+        *p++ = '\n';
+    }
+    return p;
+}
+
+} // namespace csv_detail
+
+// tx_n/rx_n samples are available on each side; missing samples (short
+// capture) are written as 0. Each round formats one chunk of rows per
+// thread, from a table of the 12-bit sample values (std::to_chars for the
+// rest); the previous round is written out, in order, while the next one is
+// formatted. A failed write stops the rounds. threads = 0 uses every core. `scratch`,
+// if given, holds the format buffers and is kept for the next call. Returns
+// false if the file could not be written.
+inline bool write_csv(const std::string& path, size_t nsamples,
+                      const int16_t* tx_i, const int16_t* tx_q, size_t tx_n,
+                      const int16_t* rx_i, const int16_t* rx_q, size_t rx_n,
+                      unsigned threads = 0, std::vector<char>* scratch = nullptr) {
+    using namespace csv_detail;
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    static const char HEADER[] = "n,tx_i,tx_q,rx_i,rx_q\n";
+    bool ok = std::fwrite(HEADER, 1, sizeof(HEADER) - 1, f) == sizeof(HEADER) - 1;
+
+    const Columns cols{tx_i, tx_q, tx_n, rx_i, rx_q, rx_n};
+    const size_t rows = std::max<size_t>(1, std::min(nsamples, CHUNK_ROWS));   // per chunk
+    const size_t chunks = (nsamples + rows - 1) / rows;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, chunks)));
+
+    // Two sets of per-thread buffers: one being formatted, one being written
+    std::vector<char>  own;
+    std::vector<char>& mem = scratch ? *scratch : own;
+    const size_t set_bytes = threads * rows * MAX_ROW;
+    if (mem.size() < 2 * set_bytes) mem.resize(2 * set_bytes);
+    char*              buf[2] = {mem.data(), mem.data() + set_bytes};
+    std::vector<char*> ends[2];
+    for (int s = 0; s < 2; ++s) ends[s].resize(threads);
+    std::thread writer;
+    std::vector<std::thread> workers;
+    for (size_t chunk = 0, round = 0; chunk < chunks; chunk += threads, ++round) {
+        const int set = round & 1;
+        auto format = [&, set, chunk](unsigned t) {
+            char* out = buf[set] + t * rows * MAX_ROW;
+            const size_t first = std::min(nsamples, (chunk + t) * rows);
+            const size_t last  = std::min(nsamples, first + rows);
+            ends[set][t] = format_rows(out, cols, first, last);
+        };
+        for (unsigned t = 1; t < threads; ++t) workers.emplace_back(format, t);
+        format(0);
+        for (std::thread& w : workers) w.join();
+        workers.clear();
+
+        if (writer.joinable()) writer.join();
+        if (!ok) break;
+        writer = std::thread([&, set] {
+            for (unsigned t = 0; t < threads && ok; ++t) {
+                const char* out = buf[set] + t * rows * MAX_ROW;
+                const size_t len = static_cast<size_t>(ends[set][t] - out);
+                ok = std::fwrite(out, 1, len, f) == len;
+            }
+        });
+    }
+    if (writer.joinable()) writer.join();
+    return std::fclose(f) == 0 && ok;
+}
+
+// ---------- Recording sink ----------
+// Destination of the RX stream when recording. write() runs on the recorder
+// thread, never on the RX thread, so it may block on disk or compress.
+class SampleSink {
+public:
+    virtual ~SampleSink() = default;
+    virtual void write(const int16_t* i, const int16_t* q, size_t n) = 0;
+    // Sample number `sample` of the stream arrived at `unix_ns` (wall clock).
+    virtual void mark_time(uint64_t /*sample*/, int64_t /*unix_ns*/) {}
+};
+
+// ---------- Single-producer/single-consumer I/Q FIFO ----------
+// Hands TX reference symbols from the TX thread to the RX thread. push()
+// never blocks: what does not fit is dropped and counted by the caller.
+class SampleFifo {
+public:
+    explicit SampleFifo(size_t min_capacity) {
+        size_t cap = 1;
+        while (cap < min_capacity) cap <<= 1;
+        i_.resize(cap);
+        q_.resize(cap);
+        mask_ = cap - 1;
+    }
+
+    // Producer side. Returns the number of samples accepted.
+    size_t push(const int16_t* i, const int16_t* q, size_t n) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        const size_t room = (mask_ + 1) - (head - tail);
+        if (n > room) n = room;
+        for (size_t k = 0; k < n; ++k) {
+            i_[(head + k) & mask_] = i[k];
+            q_[(head + k) & mask_] = q[k];
+        }
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    // Consumer side: fn(const int16_t* i, const int16_t* q, size_t n) is
+    // called on contiguous spans of everything available.
+    template <class Fn> void drain(Fn fn) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+        size_t pos = tail;
+        while (pos < head) {
+            const size_t off = pos & mask_;
+            const size_t n = std::min(head - pos, (mask_ + 1) - off);
+            fn(i_.data() + off, q_.data() + off, n);
+            pos += n;
+        }
+        tail_.store(head, std::memory_order_release);
+    }
+
+private:
+    std::vector<int16_t> i_, q_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
@@ -0,0 +1,141 @@
+// Optional timeline tracing of the streaming pipeline in Chrome trace format
+// (chrome://tracing, ui.perfetto.dev). Each thread records complete spans
+// into its own preallocated ring; the oldest spans are overwritten once a
+// ring is full. With tracing disabled a TraceScope costs one branch.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "latency.hpp"
+
+struct TraceEvent {
+    const char* name;       // string literal, never freed
+    uint64_t    begin_ns;
+    uint64_t    end_ns;
+};
+
+class TraceRing {
+public:
+    void init(size_t capacity, int tid) {
+        size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        ev_.assign(cap, TraceEvent{nullptr, 0, 0});
+        mask_ = cap - 1;
+        tid_ = tid;
+    }
+
+    void add(const char* name, uint64_t b, uint64_t e) {
+        ev_[next_ & mask_] = TraceEvent{name, b, e};
+        ++next_;
+    }
+
+    int         tid()  const { return tid_; }
+    const char* name() const { return name_; }
+    void set_name(const char* n) { name_ = n; }
+
+    // Calls fn(event) oldest first.
+    template <class Fn> void for_each(Fn fn) const {
+        const size_t n = next_ < ev_.size() ? next_ : ev_.size();
+        for (size_t k = next_ - n; k < next_; ++k) fn(ev_[k & mask_]);
+    }
+
+private:
+    std::vector<TraceEvent> ev_;
+    size_t mask_ = 0, next_ = 0;
+    int tid_ = 0;
+    const char* name_ = "";
+};
+
+class Tracer {
+public:
+    static constexpr int MAX_THREADS = 8;
+
+    // Preallocates every ring up front so recording never allocates.
+    void enable(size_t events_per_thread) {
+        for (int t = 0; t < MAX_THREADS; ++t) rings_[t].init(events_per_thread, t + 1);
+        t0_ = mono_ns();
+        enabled_ = true;
+    }
+
+    bool enabled() const { return enabled_; }
+
+    // Claims a ring for the calling thread; no-op if tracing is off, the
+    // thread already has one, or all rings are taken. A ring whose name
+    // matches is reused, so short-lived threads started once per run (only
+    // one alive per name) share one timeline row.
+    void register_thread(const char* name);
+
+    bool dump(const std::string& path) const {
+        std::FILE* f = std::fopen(path.c_str(), "w");
+        if (!f) return false;
+        std::fprintf(f, "{\"traceEvents\":[\n");
+        bool first = true;
+        const int used = used_.load();
+        for (int t = 0; t < used; ++t) {
+            const TraceRing& r = rings_[t];
+            std::fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                            "\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", r.tid(), r.name());
+            first = false;
+            r.for_each([&](const TraceEvent& e) {
+                if (!e.name) return;
+                std::fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                                "\"ts\":%.3f,\"dur\":%.3f}",
+                             e.name, r.tid(), (e.begin_ns - t0_) * 1e-3,
+                             (e.end_ns - e.begin_ns) * 1e-3);
+            });
+        }
+        std::fprintf(f, "\n],\"displayTimeUnit\":\"ns\"}\n");
+        return std::fclose(f) == 0;
+    }
+
+private:
+    TraceRing rings_[MAX_THREADS];
+    std::atomic<int> used_{0};
+    std::mutex register_mu_;
+    uint64_t t0_ = 0;
+    bool enabled_ = false;
+};
+
+inline Tracer& tracer() {
+    static Tracer t;
+    return t;
+}
+
+inline thread_local TraceRing* t_trace_ring = nullptr;
+
+inline void Tracer::register_thread(const char* name) {
+    if (!enabled_ || t_trace_ring) return;
+    std::lock_guard<std::mutex> lock(register_mu_);
+    const int used = used_.load();
+    for (int t = 0; t < used; ++t) {
+        if (std::strcmp(rings_[t].name(), name) == 0) {
+            t_trace_ring = &rings_[t];
+            return;
+        }
+    }
+    if (used >= MAX_THREADS) return;
+    rings_[used].set_name(name);
+    used_.store(used + 1);
+    t_trace_ring = &rings_[used];
+}
+
+// Records one span from construction to destruction on the current thread.
+class TraceScope {
+public:
+    explicit TraceScope(const char* name)
+        : ring_(t_trace_ring), name_(name), begin_(ring_ ? mono_ns() : 0) {}
+    ~TraceScope() { if (ring_) ring_->add(name_, begin_, mono_ns()); }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    TraceRing*  ring_;
+    const char* name_;
+    uint64_t    begin_;
+};